@@ -0,0 +1,311 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Component benchmarks for ingest and render paths.
+ *
+ * Results are printed as JSON on standard output so they can be compared
+ * between builds. Runs with "offscreen" platform by default (Qt 5).
+ *
+ *   traypost_bench [minimum time per benchmark in ms] > results.json
+ */
+
+#include "console_reader.h"
+#include "icon_renderer.h"
+#include "line_splitter.h"
+#include "message_format.h"
+#include "record_store.h"
+#include "tool_tip.h"
+#include "tray.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QPainter>
+#include <QThread>
+
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+using namespace traypost;
+
+namespace {
+
+struct Result {
+    QString name;
+    qint64 iterations;
+    qint64 items;
+    qint64 nanoseconds;
+};
+
+QList<Result> results;
+
+int minTimeMs = 500;
+
+/**
+ * Run function repeatedly for at least minimum time.
+ * @param itemsPerIteration number of processed items (lines, records) per call
+ */
+void benchmark(const QString &name, qint64 itemsPerIteration, const std::function<void()> &fn)
+{
+    // Warm up caches.
+    fn();
+
+    Result result;
+    result.name = name;
+    result.iterations = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        fn();
+        ++result.iterations;
+    } while ( timer.elapsed() < minTimeMs );
+
+    result.nanoseconds = timer.nsecsElapsed();
+    result.items = result.iterations * itemsPerIteration;
+    results.append(result);
+
+    std::cerr << name.toStdString() << ": "
+              << result.nanoseconds / result.iterations << " ns/iteration" << std::endl;
+}
+
+QString jsonString(const QString &text)
+{
+    QString result = text;
+    result.replace('\\', "\\\\").replace('"', "\\\"");
+    return '"' + result + '"';
+}
+
+void printResults()
+{
+    std::cout << "{\n  \"qt_version\": " << jsonString(qVersion()).toStdString()
+              << ",\n  \"benchmarks\": [";
+
+    for (int i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        const double seconds = result.nanoseconds / 1e9;
+        std::cout << (i == 0 ? "\n" : ",\n")
+                  << "    {\"name\": " << jsonString(result.name).toStdString()
+                  << ", \"iterations\": " << result.iterations
+                  << ", \"ns_per_iteration\": " << result.nanoseconds / result.iterations
+                  << ", \"items_per_second\": " << static_cast<qint64>(result.items / seconds)
+                  << "}";
+    }
+
+    std::cout << "\n  ]\n}" << std::endl;
+}
+
+QString sampleLine(int i)
+{
+    return QString("%1 host-%2 kernel: [%3] usb 1-%4: new high-speed USB device number %5")
+            .arg(i).arg(i % 16).arg(i * 0.001, 0, 'f', 6).arg(i % 4).arg(i % 128);
+}
+
+/**
+ * Lines per second from a pipe through ConsoleReader to Tray.
+ */
+void benchmarkIngest()
+{
+    constexpr int lineCount = 100000;
+
+    QByteArray input;
+    for (int i = 0; i < lineCount; ++i)
+        input.append( sampleLine(i).toUtf8() ).append('\n');
+
+    benchmark("ingest/console_reader_to_tray", lineCount, [&]() {
+        int fds[2];
+        if ( pipe(fds) != 0 )
+            qFatal("Cannot create pipe");
+
+        Tray tray;
+        auto reader = new ConsoleReader();
+        reader->addInput(fds[0], "pipe");
+        QThread thread;
+        reader->moveToThread(&thread);
+
+        QObject::connect( &thread, SIGNAL(started()), reader, SLOT(readLines()) );
+        QObject::connect( reader, SIGNAL(newRecords(QVector<traypost::Record>)),
+                          &tray, SLOT(onInputRecords(QVector<traypost::Record>)) );
+        QObject::connect( &tray, SIGNAL(inputProcessed()), reader, SLOT(releaseBatch()),
+                          Qt::DirectConnection );
+
+        QEventLoop loop;
+        QObject::connect( reader, SIGNAL(finished()), &loop, SLOT(quit()), Qt::QueuedConnection );
+
+        thread.start();
+
+        // Write input from other thread so the pipe doesn't block.
+        std::thread writer([&]() {
+            const char *data = input.constData();
+            qint64 remaining = input.size();
+            while (remaining > 0) {
+                const ssize_t written = ::write(fds[1], data, remaining);
+                if (written <= 0)
+                    break;
+                data += written;
+                remaining -= written;
+            }
+            ::close(fds[1]);
+        });
+
+        loop.exec();
+        writer.join();
+
+        thread.quit();
+        thread.wait();
+        delete reader;
+    });
+}
+
+/**
+ * Bytes per second split to lines (without decoding).
+ */
+void benchmarkLineSplit()
+{
+    constexpr int lineCount = 100000;
+
+    QByteArray input;
+    for (int i = 0; i < lineCount; ++i)
+        input.append( sampleLine(i).toUtf8() ).append('\n');
+
+    int lines = 0;
+    benchmark("split/find_line_end_bytes", input.size(), [&]() {
+        const char *start = input.constData();
+        const char *end = start + input.size();
+        bool ascii = true;
+        while (start != end) {
+            start = findLineEnd(start, end, &ascii);
+            if (start != end)
+                ++start;
+            ++lines;
+        }
+    });
+
+    if (lines == 0)
+        qFatal("No lines found");
+}
+
+void benchmarkFormat()
+{
+    constexpr int recordCount = 1000;
+
+    const MessageFormat format("<p><small><b>%2</b></small><br />%1</p>", "dd.MM.yyyy hh:mm:ss.zzz");
+
+    QList<Record> records;
+    for (int i = 0; i < recordCount; ++i)
+        records.append( Record(sampleLine(i) + " <tag> & \"quoted\"") );
+
+    // Unique IDs so escaped texts are not cached.
+    qint64 id = 0;
+    benchmark("format/record_uncached", recordCount, [&]() {
+        for (const Record &record : records)
+            format.format(record, id++);
+    });
+
+    benchmark("format/record_cached", recordCount, [&]() {
+        for (int i = 0; i < recordCount; ++i)
+            format.format(records[i], i);
+    });
+}
+
+void benchmarkIconRender()
+{
+    QIcon icon;
+    for (int size : {16, 22, 24, 32, 48, 64}) {
+        QPixmap pix(size, size);
+        pix.fill(Qt::darkCyan);
+        icon.addPixmap(pix);
+    }
+
+    IconRenderer renderer;
+    renderer.setIcon(icon);
+    renderer.setTextStyle( QApplication::font(), Qt::black, Qt::white );
+
+    for ( const QSize &size : icon.availableSizes() ) {
+        int counter = 0;
+        benchmark( QString("icon/render_%1x%2").arg(size.width()).arg(size.height()), 1, [&]() {
+            renderer.pixmap( QString::number(++counter), size );
+        });
+    }
+
+    int counter = 0;
+    benchmark("icon/tray_icon_current_size", 1, [&]() {
+        renderer.icon( QString::number(++counter), QSize(22, 22) );
+    });
+}
+
+void benchmarkToolTip()
+{
+    constexpr int recordCount = 10000;
+
+    const MessageFormat format("<p><small><b>%2</b></small><br />%1</p>", "dd.MM.yyyy hh:mm:ss.zzz");
+
+    RecordsToolTip toolTip(10);
+    QVector<Record> records;
+    for (int i = 0; i < recordCount; ++i)
+        records.append( Record(sampleLine(i)) );
+
+    qint64 id = 0;
+    benchmark("tooltip/append_record", 1, [&]() {
+        toolTip.append( records[id % recordCount], id );
+        ++id;
+    });
+
+    // Tool tip after each new record (only the new one is formatted).
+    benchmark("tooltip/append_and_show", 1, [&]() {
+        toolTip.append( records[id % recordCount], id );
+        ++id;
+        toolTip.toHtml(format);
+    });
+
+    // Tool tip after batch of new records.
+    benchmark("tooltip/last_10_records", 10, [&]() {
+        for (int i = 0; i < 10; ++i, ++id)
+            toolTip.append( records[id % recordCount], id );
+        toolTip.toHtml(format);
+    });
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+#if QT_VERSION >= 0x050000
+    if ( qgetenv("QT_QPA_PLATFORM").isEmpty() )
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+
+    QApplication app(argc, argv);
+
+    if (argc > 1)
+        minTimeMs = QString(argv[1]).toInt();
+
+    benchmarkLineSplit();
+    benchmarkIngest();
+    benchmarkFormat();
+    benchmarkIconRender();
+    benchmarkToolTip();
+
+    printResults();
+
+    return 0;
+}
@@ -18,33 +18,539 @@
 */
 
 #include "console_reader.h"
+#include "line_splitter.h"
+#include "post_client.h"
+#include "statistics.h"
 
-#include <QTimer>
-#include <QThread>
+#include <QFile>
+#include <QTextCodec>
+
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 namespace traypost {
 
+namespace {
+
+/// Number of batches which can be delivered but not yet processed.
+constexpr int maxPendingBatches = 4;
+
+constexpr int readBufferSize = 64 * 1024;
+
+/// Maximum number of inputs and sources from structured lines.
+constexpr int maxSources = 1024;
+
+/// IANA MIB enum for UTF-8.
+constexpr int utf8MibEnum = 106;
+
+/// 64-bit FNV-1a hash (collisions are unlikely enough to drop distinct lines).
+quint64 hashLine(const char *data, int size)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < size; ++i) {
+        hash ^= static_cast<uchar>(data[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+} // namespace
+
 ConsoleReader::ConsoleReader(QObject *parent)
     : QObject(parent)
-    , in_(stdin)
+    , inputs_()
+    , inputNames_()
+    , codec_( QTextCodec::codecForLocale() )
+    , utf8_( codec_->mibEnum() == utf8MibEnum )
+    , batch_()
+    , batchTimer_()
+    , batchSize_(1000)
+    , batchLatency_(50)
+    , freeBatches_(maxPendingBatches)
+    , linesRead_(0)
+    , foldRepeats_(false)
+    , lastLine_()
+    , lastSource_(0)
+    , hasLastLine_(false)
+    , pendingRepeats_(0)
+    , pendingLastSeen_(0)
+    , dedupWindow_(0)
+    , dedupRing_()
+    , dedupIndex_(0)
+    , dedupCounts_()
+    , inputFormat_(PlainInput)
+    , fieldSources_()
+    , sourcesChanged_(false)
+    , lineFilter_()
+    , filterHits_()
+    , linesFiltered_(0)
+    , highlighter_()
+{
+    qRegisterMetaType< QVector<traypost::Record> >("QVector<traypost::Record>");
+}
+
+void ConsoleReader::setBatchSize(int lines)
 {
+    batchSize_ = qMax(1, lines);
+}
+
+void ConsoleReader::setBatchLatency(int ms)
+{
+    batchLatency_ = qMax(0, ms);
+}
+
+void ConsoleReader::setFoldRepeats(bool enable)
+{
+    foldRepeats_ = enable;
+}
+
+void ConsoleReader::setDedupWindow(int lines)
+{
+    dedupWindow_ = qMax(0, lines);
+    dedupRing_.clear();
+    dedupIndex_ = 0;
+    dedupCounts_.clear();
+}
+
+bool ConsoleReader::openInput(const QString &path, QString *errorString)
+{
+    if (path == "-") {
+        addInput(0, QString("stdin"));
+        return true;
+    }
+
+    const QByteArray fileName = QFile::encodeName(path);
+    struct stat st;
+    int fd = -1;
+
+    if ( ::stat(fileName.constData(), &st) == 0 ) {
+        if ( S_ISSOCK(st.st_mode) ) {
+            fd = connectToDaemon( std::string(fileName.constData(), fileName.size()) );
+        } else if ( S_ISFIFO(st.st_mode) ) {
+            // Opened also for writing so writers can come and go without EOF.
+            fd = ::open(fileName.constData(), O_RDWR);
+        } else {
+            fd = ::open(fileName.constData(), O_RDONLY);
+        }
+    }
+
+    if (fd == -1) {
+        if (errorString != nullptr) {
+            *errorString = tr("Cannot open input \"%1\": %2")
+                    .arg(path).arg( QString::fromLocal8Bit(strerror(errno)) );
+        }
+        return false;
+    }
+
+    addInput(fd, path);
+    return true;
+}
+
+bool ConsoleReader::listen(const QString &path, QString *errorString)
+{
+    const QByteArray fileName = QFile::encodeName(path);
+    struct sockaddr_un address;
+    int fd = -1;
+
+    if ( !checkSocketDirectory(std::string(fileName.constData(), fileName.size()), true) ) {
+        if (errorString != nullptr) {
+            *errorString = tr("Unsafe socket directory for \"%1\": %2")
+                    .arg(path).arg( QString::fromLocal8Bit(strerror(errno)) );
+        }
+        return false;
+    }
+
+    const int client = connectToDaemon( std::string(fileName.constData(), fileName.size()) );
+    if (client != -1) {
+        ::close(client);
+        if (errorString != nullptr)
+            *errorString = tr("Other daemon is already listening on \"%1\"").arg(path);
+        return false;
+    }
+
+    // Remove socket left by daemon which didn't exit properly.
+    struct stat st;
+    if ( ::stat(fileName.constData(), &st) == 0 && S_ISSOCK(st.st_mode) )
+        ::unlink( fileName.constData() );
+
+    if ( fileName.size() >= static_cast<int>(sizeof(address.sun_path)) ) {
+        errno = ENAMETOOLONG;
+    } else {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy( address.sun_path, fileName.constData(), fileName.size() );
+
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        // Create socket accessible only by user (no window before chmod()).
+        const mode_t oldMask = ::umask(S_IRWXG | S_IRWXO);
+        const bool bound = fd != -1
+            && ::bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+        const int bindError = errno;
+        ::umask(oldMask);
+        errno = bindError;
+
+        if ( fd != -1
+             && (!bound
+                 || ::chmod(fileName.constData(), S_IRUSR | S_IWUSR) != 0
+                 || ::listen(fd, SOMAXCONN) != 0) )
+        {
+            const int error = errno;
+            ::close(fd);
+            fd = -1;
+            errno = error;
+        }
+    }
+
+    if (fd == -1) {
+        if (errorString != nullptr) {
+            *errorString = tr("Cannot listen on \"%1\": %2")
+                    .arg(path).arg( QString::fromLocal8Bit(strerror(errno)) );
+        }
+        return false;
+    }
+
+    addInput(fd, path);
+    inputs_.last().listening = true;
+    return true;
+}
+
+void ConsoleReader::addInput(int fd, const QString &name)
+{
+    addInput(fd, inputNames_.size());
+    inputNames_.append(name);
+}
+
+void ConsoleReader::addInput(int fd, int source)
+{
+    Input input;
+    input.fd = fd;
+    input.source = source;
+    input.listening = false;
+    input.separator = '\n';
+    input.scanned = 0;
+    input.scannedAscii = true;
+    inputs_.append(input);
+}
+
+void ConsoleReader::setInputFormat(InputFormat format)
+{
+    inputFormat_ = format;
+}
+
+void ConsoleReader::setLineFilter(const LineFilter &filter)
+{
+    lineFilter_ = filter;
+    const QStringList patterns = filter.patterns();
+    filterHits_.fill( 0, patterns.size() );
+    Statistics::global().setFilters(patterns);
+}
+
+void ConsoleReader::setHighlighter(const KeywordMatcher &highlighter)
+{
+    highlighter_ = highlighter;
 }
 
 void ConsoleReader::readLines()
 {
-    if ( in_.atEnd() ) {
-        emit finished();
+    if ( inputs_.isEmpty() )
+        addInput(0, QString("stdin"));
+
+    emit sourcesChanged(inputNames_);
+
+    char chunk[readBufferSize];
+    QVector<struct pollfd> pfds;
+
+    while ( !inputs_.isEmpty() ) {
+        // Wait for more input only until the oldest line in batch is too old.
+        int timeout = -1;
+        if ( hasPendingInput() )
+            timeout = static_cast<int>( qMax<qint64>(0, batchLatency_ - batchTimer_.elapsed()) );
+
+        pfds.resize( inputs_.size() );
+        for (int i = 0; i < inputs_.size(); ++i) {
+            pfds[i].fd = inputs_[i].fd;
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+
+        const int ready = ::poll(pfds.data(), pfds.size(), timeout);
+        if (ready == 0) {
+            flush();
+            continue;
+        }
+
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        // Iterate backwards so closed inputs can be removed.
+        for (int i = inputs_.size() - 1; i >= 0; --i) {
+            if (pfds[i].revents == 0)
+                continue;
+
+            if (inputs_[i].listening) {
+                acceptClient(i);
+                continue;
+            }
+
+            Input &input = inputs_[i];
+            const ssize_t size = ::read(input.fd, chunk, sizeof(chunk));
+            if ( size < 0 && (errno == EINTR || errno == EAGAIN) )
+                continue;
+
+            if (size <= 0) {
+                closeInput(i);
+                continue;
+            }
+
+            input.buffer.append(chunk, static_cast<int>(size));
+            splitLines(&input);
+        }
+
+        // Busy input must not delay batch past its deadline.
+        if ( hasPendingInput() && batchTimer_.elapsed() >= batchLatency_ )
+            flush();
+    }
+
+    while ( !inputs_.isEmpty() )
+        closeInput(inputs_.size() - 1);
+
+    flush();
+    emit finished();
+}
+
+void ConsoleReader::releaseBatch()
+{
+    --Statistics::global().pendingBatches;
+    freeBatches_.release();
+}
+
+void ConsoleReader::acceptClient(int index)
+{
+    const int fd = ::accept4(inputs_[index].fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd != -1) {
+        addInput( fd, inputs_[index].source );
+        inputs_.last().separator = '\0';
+    }
+}
+
+void ConsoleReader::splitLines(Input *input)
+{
+    QByteArray &buffer = input->buffer;
+    const char *data = buffer.constData();
+    const char *dataEnd = data + buffer.size();
+    const char *start = data;
+
+    // Continue after part of incomplete line searched by previous call.
+    const char *scanStart = data + input->scanned;
+    bool ascii = input->scannedAscii;
+    forever {
+        const char *end = findLineEnd(scanStart, dataEnd, &ascii, input->separator);
+        if (end == dataEnd)
+            break;
+
+        if ( !hasPendingInput() )
+            batchTimer_.start();
+        addLine( input->source, start, static_cast<int>(end - start), ascii );
+        start = end + 1;
+        scanStart = start;
+        ascii = true;
+    }
+    buffer.remove( 0, static_cast<int>(start - data) );
+    input->scanned = buffer.size();
+    input->scannedAscii = ascii;
+}
+
+void ConsoleReader::closeInput(int index)
+{
+    Input &input = inputs_[index];
+
+    // Last line without new line character at the end.
+    if ( !input.buffer.isEmpty() ) {
+        // Whole buffer was already scanned by splitLines().
+        const bool ascii = input.scannedAscii;
+        if ( !hasPendingInput() )
+            batchTimer_.start();
+        addLine( input.source, input.buffer.constData(), input.buffer.size(), ascii );
+    }
+
+    if (input.fd != 0)
+        ::close(input.fd);
+
+    inputs_.remove(index);
+}
+
+void ConsoleReader::addLine(int source, const char *data, int size, bool ascii)
+{
+    if ( size > 0 && data[size - 1] == '\r' )
+        --size;
+
+    ++linesRead_;
+
+    if ( !lineFilter_.isEmpty()
+         && !lineFilter_.accepts(data, size, ascii, utf8_ ? nullptr : codec_, filterHits_.data()) )
+    {
+        ++linesFiltered_;
         return;
     }
 
-    QString line = in_.readLine();
+    // Lines are compared as raw bytes so repeats are not decoded at all.
+    if ( foldRepeats_ && hasLastLine_ && source == lastSource_ && size == lastLine_.size()
+         && memcmp(data, lastLine_.constData(), size) == 0 )
+    {
+        const qint64 now = Record::currentTime();
+        ++Statistics::global().linesFolded;
+        if ( batch_.isEmpty() ) {
+            // Repeats of record in already delivered batch.
+            ++pendingRepeats_;
+            pendingLastSeen_ = now;
+        } else {
+            Record &record = batch_.last();
+            ++record.repeats;
+            record.lastSeen = now;
+        }
+        return;
+    }
 
-    if ( in_.atEnd() ) {
-        if ( !line.isEmpty() )
-            emit newLine(line);
+    if ( dedupWindow_ > 0 && isDuplicate(data, size) ) {
+        ++Statistics::global().linesDeduplicated;
+        hasLastLine_ = false;
+        return;
+    }
+
+    if (foldRepeats_) {
+        lastLine_ = QByteArray(data, size);
+        lastSource_ = source;
+        hasLastLine_ = true;
+    }
+
+    Record record;
+    record.time = Record::currentTime();
+    record.eventTime = record.time;
+    record.source = source;
+    record.text = decodeLine(data, size, ascii, &record);
+    if ( !highlighter_.isEmpty() )
+        record.highlights = highlighter_.find(record.text);
+    record.lastSeen = record.time;
+    batch_.append(record);
+
+    if (batch_.size() >= batchSize_)
+        flush();
+}
+
+bool ConsoleReader::isDuplicate(const char *data, int size)
+{
+    const quint64 hash = hashLine(data, size);
+    const bool found = dedupCounts_.contains(hash);
+
+    // Rolling window of hashes of last lines.
+    if ( dedupRing_.size() < dedupWindow_ ) {
+        dedupRing_.append(hash);
     } else {
-        emit newLine(line);
+        quint64 &oldHash = dedupRing_[dedupIndex_];
+        auto it = dedupCounts_.find(oldHash);
+        if ( --it.value() == 0 )
+            dedupCounts_.erase(it);
+        oldHash = hash;
+        dedupIndex_ = (dedupIndex_ + 1) % dedupWindow_;
+    }
+    ++dedupCounts_[hash];
+
+    return found;
+}
+
+QString ConsoleReader::decodeLine(const char *data, int size, bool ascii, Record *record)
+{
+    LineFields fields;
+    if ( inputFormat_ != PlainInput && parseLineFields(data, size, inputFormat_, &fields) ) {
+        record->level = parseLevel(fields.level);
+
+        qint64 time;
+        if ( !fields.time.isNull() && parseTime(fields.time, &time) )
+            record->eventTime = time;
+
+        if ( !fields.source.isNull() && fields.source.size > 0 ) {
+            const int source = sourceForName( fieldText(fields.source) );
+            if (source != -1)
+                record->source = source;
+        }
+
+        if ( !fields.message.isNull() ) {
+            if (ascii && !fields.message.escaped)
+                return QString::fromLatin1(fields.message.data, fields.message.size);
+            return fieldText(fields.message);
+        }
+    }
+
+    // Locale encodings are ASCII compatible so plain ASCII lines can be copied
+    // directly; QString::fromUtf8() replaces invalid sequences.
+    if (ascii)
+        return QString::fromLatin1(data, size);
+    if (utf8_)
+        return QString::fromUtf8(data, size);
+    return codec_->toUnicode(data, size);
+}
+
+int ConsoleReader::sourceForName(const QString &name)
+{
+    const QHash<QString, int>::const_iterator it = fieldSources_.constFind(name);
+    if ( it != fieldSources_.constEnd() )
+        return it.value();
+
+    // Too many distinct values are probably not sources; keep input index.
+    if ( inputNames_.size() >= maxSources )
+        return -1;
+
+    const int source = inputNames_.size();
+    inputNames_.append(name);
+    fieldSources_.insert(name, source);
+    sourcesChanged_ = true;
+    return source;
+}
+
+void ConsoleReader::flush()
+{
+    Statistics &stats = Statistics::global();
+    stats.linesRead += linesRead_;
+    linesRead_ = 0;
+
+    stats.linesFiltered += linesFiltered_;
+    linesFiltered_ = 0;
+    for (int i = 0; i < filterHits_.size(); ++i) {
+        stats.filterHits[i] += filterHits_[i];
+        filterHits_[i] = 0;
     }
+
+    if (pendingRepeats_ > 0) {
+        emit repeated(pendingRepeats_, pendingLastSeen_);
+        pendingRepeats_ = 0;
+    }
+
+    if ( batch_.isEmpty() )
+        return;
+
+    if (sourcesChanged_) {
+        sourcesChanged_ = false;
+        emit sourcesChanged(inputNames_);
+    }
+
+    // Block if receiver is too slow so the input pipe is not read infinitely.
+    freeBatches_.acquire();
+
+    ++stats.pendingBatches;
+
+    emit newRecords(batch_);
+    batch_.clear();
 }
 
 } // namespace traypost
@@ -19,26 +19,217 @@
 
 #pragma once
 
+#include "keyword_matcher.h"
+#include "line_filter.h"
+#include "line_parser.h"
+#include "record.h"
+
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
-#include <QTextStream>
+#include <QSemaphore>
+#include <QStringList>
+#include <QVector>
+
+class QTextCodec;
 
 namespace traypost {
 
+/**
+ * Reads lines from inputs in single thread.
+ *
+ * All inputs are multiplexed with poll() and each record is tagged with index
+ * of its input (see inputNames()). Reads standard input if no input is added.
+ */
 class ConsoleReader : public QObject {
     Q_OBJECT
 public:
     explicit ConsoleReader(QObject *parent = nullptr);
 
+    /**
+     * Open input by path ("-" for standard input).
+     *
+     * Path can be regular file (read until end), FIFO (kept open for new
+     * writers) or Unix socket (connected to).
+     */
+    bool openInput(const QString &path, QString *errorString = nullptr);
+
+    /**
+     * Listen on Unix socket and read lines from all connected clients (as
+     * single input).
+     */
+    bool listen(const QString &path, QString *errorString = nullptr);
+
+    /**
+     * Add opened file descriptor as input (closed at end unless it's 0).
+     */
+    void addInput(int fd, const QString &name);
+
+    /**
+     * Return input names (indexes are record sources).
+     */
+    const QStringList &inputNames() const { return inputNames_; }
+
+    /**
+     * Set maximum number of lines delivered in one batch.
+     */
+    void setBatchSize(int lines);
+
+    /**
+     * Set maximum time (in milliseconds) a line can wait for other lines
+     * before its batch is delivered.
+     */
+    void setBatchLatency(int ms);
+
+    /**
+     * Collapse consecutive identical lines into single record with repeat
+     * count.
+     */
+    void setFoldRepeats(bool enable);
+
+    /**
+     * Drop lines identical to any of last @a lines lines (0 to disable).
+     */
+    void setDedupWindow(int lines);
+
+    /**
+     * Parse message, level, time and source from structured lines (lines in
+     * other format are kept as plain text).
+     *
+     * New values of source field are appended to input names.
+     */
+    void setInputFormat(InputFormat format);
+
+    /**
+     * Drop lines rejected by filter before they are decoded into records
+     * (must be called before reading starts).
+     *
+     * Hit counts of filters are added to statistics.
+     */
+    void setLineFilter(const LineFilter &filter);
+
+    /**
+     * Set keywords highlighted in new records.
+     */
+    void setHighlighter(const KeywordMatcher &highlighter);
+
 signals:
-    void newLine(const QString &line);
+    /**
+     * Input names changed (emitted before records with new sources).
+     */
+    void sourcesChanged(const QStringList &names);
+
+    void newRecords(const QVector<traypost::Record> &records);
+
+    /**
+     * Last record of previously delivered batch was repeated @a count more
+     * times (emitted only if repeats are folded).
+     */
+    void repeated(int count, qint64 lastSeen);
 
     void finished();
 
 public slots:
     void readLines();
 
+    /**
+     * Allow reader to deliver another batch (can be called from any thread).
+     */
+    void releaseBatch();
+
 private:
-    QTextStream in_;
+    struct Input {
+        int fd;
+        int source;
+        /// Accept new clients instead of reading.
+        bool listening;
+        /// Ends lines (NUL for messages posted to daemon, which can be multi-line).
+        char separator;
+        /// Incomplete last line.
+        QByteArray buffer;
+        /// Size of buffer already searched for new line.
+        int scanned;
+        /// Scanned part of buffer is 7-bit ASCII.
+        bool scannedAscii;
+    };
+
+    void addInput(int fd, int source);
+
+    /**
+     * Accept client on listening socket and add it as input.
+     */
+    void acceptClient(int index);
+
+    /**
+     * Add complete lines from input buffer to batch.
+     */
+    void splitLines(Input *input);
+
+    /**
+     * Add incomplete last line, close and remove input.
+     */
+    void closeInput(int index);
+
+    /**
+     * Decode line and add it to batch; @a ascii is true if line contains
+     * only 7-bit ASCII characters.
+     */
+    void addLine(int source, const char *data, int size, bool ascii);
+
+    /**
+     * Return true if line was seen in deduplication window and add it to the
+     * window.
+     */
+    bool isDuplicate(const char *data, int size);
+
+    /**
+     * Return text of line and set level, time and source parsed from
+     * structured line.
+     */
+    QString decodeLine(const char *data, int size, bool ascii, Record *record);
+
+    /**
+     * Return source index for value of source field (-1 if there are too
+     * many sources).
+     */
+    int sourceForName(const QString &name);
+
+    bool hasPendingInput() const { return !batch_.isEmpty() || pendingRepeats_ > 0; }
+
+    void flush();
+
+    QVector<Input> inputs_;
+    QStringList inputNames_;
+    QTextCodec *codec_;
+    bool utf8_;
+    QVector<Record> batch_;
+    QElapsedTimer batchTimer_;
+    int batchSize_;
+    int batchLatency_;
+    QSemaphore freeBatches_;
+    qint64 linesRead_;
+
+    bool foldRepeats_;
+    QByteArray lastLine_;
+    int lastSource_;
+    bool hasLastLine_;
+    int pendingRepeats_;
+    qint64 pendingLastSeen_;
+
+    int dedupWindow_;
+    QVector<quint64> dedupRing_;
+    int dedupIndex_;
+    QHash<quint64, int> dedupCounts_;
+
+    InputFormat inputFormat_;
+    QHash<QString, int> fieldSources_;
+    bool sourcesChanged_;
+
+    LineFilter lineFilter_;
+    QVector<qint64> filterHits_;
+    qint64 linesFiltered_;
+
+    KeywordMatcher highlighter_;
 };
 
 } // namespace traypost
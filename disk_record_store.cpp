@@ -0,0 +1,287 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "disk_record_store.h"
+
+#include <QFile>
+#include <QTemporaryFile>
+
+#include <cstring>
+#include <iostream>
+
+namespace traypost {
+
+struct DiskRecordStore::IndexEntry {
+    /// Offset of text in data file.
+    qint64 offset;
+    /// Arrival time in milliseconds since epoch.
+    qint64 time;
+    /// Time parsed from input.
+    qint64 eventTime;
+    /// Time of last repeat.
+    qint64 lastSeen;
+    /// Size of UTF-8 text and highlights.
+    quint32 length;
+    /// Number of consecutive occurrences.
+    quint32 repeats;
+    /// Index of input.
+    quint32 source;
+    /// Record::Level.
+    quint16 level;
+    /// Number of highlights after text.
+    quint16 highlights;
+};
+
+namespace {
+
+constexpr qint64 initialDataCapacity = 1024 * 1024;
+constexpr qint64 initialIndexEntries = 64 * 1024;
+
+qint64 roundToPage(qint64 size)
+{
+    return (size + 4095) / 4096 * 4096;
+}
+
+} // namespace
+
+DiskRecordStore::DiskRecordStore()
+    : RecordStore()
+    , dataFile_()
+    , indexFile_()
+    , data_(nullptr)
+    , dataSize_(0)
+    , dataCapacity_(0)
+    , index_(nullptr)
+    , indexSize_(0)
+    , indexCapacity_(0)
+    , firstEntry_(0)
+    , errorString_()
+    , errorReported_(false)
+{
+}
+
+DiskRecordStore::~DiskRecordStore()
+{
+    close();
+}
+
+bool DiskRecordStore::open(const QString &path)
+{
+    close();
+
+    if ( path.isEmpty() ) {
+        dataFile_.reset( new QTemporaryFile() );
+        indexFile_.reset( new QTemporaryFile() );
+    } else {
+        dataFile_.reset( new QFile(path) );
+        indexFile_.reset( new QFile(path + ".idx") );
+    }
+
+    for ( QFile *file : {dataFile_.get(), indexFile_.get()} ) {
+        if ( !file->open(QIODevice::ReadWrite | QIODevice::Truncate) ) {
+            errorString_ = QObject::tr("Cannot open file \"%1\": %2")
+                    .arg( file->fileName() ).arg( file->errorString() );
+            close();
+            return false;
+        }
+    }
+
+    return reserve(dataFile_.get(), &data_, &dataCapacity_, initialDataCapacity)
+        && reserve(indexFile_.get(), &index_, &indexCapacity_,
+                   initialIndexEntries * sizeof(IndexEntry));
+}
+
+qint64 DiskRecordStore::appendRecord(const Record &record)
+{
+    int highlightCount;
+    const QByteArray bytes = recordData(record, &highlightCount);
+
+    if ( !reserve(dataFile_.get(), &data_, &dataCapacity_, dataSize_ + bytes.size())
+         || !reserve(indexFile_.get(), &index_, &indexCapacity_, indexSize_ + sizeof(IndexEntry)) )
+    {
+        // Report only first failure, e.g. when disk is full.
+        if (!errorReported_) {
+            errorReported_ = true;
+            std::cerr << errorString_.toLocal8Bit().constData() << std::endl;
+        }
+        return -1;
+    }
+
+    memcpy( data_ + dataSize_, bytes.constData(), bytes.size() );
+
+    IndexEntry *entry = reinterpret_cast<IndexEntry*>(index_ + indexSize_);
+    entry->offset = dataSize_;
+    entry->time = record.time;
+    entry->eventTime = record.eventTime;
+    entry->lastSeen = record.lastSeen;
+    entry->length = bytes.size();
+    entry->repeats = record.repeats;
+    entry->source = record.source;
+    entry->level = record.level;
+    entry->highlights = highlightCount;
+
+    dataSize_ += bytes.size();
+    indexSize_ += sizeof(IndexEntry);
+
+    return bytes.size();
+}
+
+qint64 DiskRecordStore::removeFirstRecord()
+{
+    const qint64 bytes = entry(0).length;
+    ++firstEntry_;
+
+    // Move remaining records to beginning of files once removed ones take
+    // more space (copying is amortized over removed records).
+    const int liveCount = size() - 1;
+    if (firstEntry_ > liveCount)
+        compact(liveCount);
+
+    return bytes;
+}
+
+void DiskRecordStore::addRepeats(int row, int count, qint64 lastSeen)
+{
+    IndexEntry &e = entry(row);
+    e.repeats += count;
+    e.lastSeen = lastSeen;
+}
+
+Record DiskRecordStore::recordAt(int row) const
+{
+    const IndexEntry &e = entry(row);
+
+    Record record;
+    readRecordData( reinterpret_cast<const char*>(data_ + e.offset), e.length, e.highlights, &record );
+    record.time = e.time;
+    record.eventTime = e.eventTime;
+    record.lastSeen = e.lastSeen;
+    record.repeats = e.repeats;
+    record.source = e.source;
+    record.level = static_cast<Record::Level>(e.level);
+    return record;
+}
+
+qint64 DiskRecordStore::recordTime(int row) const
+{
+    return entry(row).time;
+}
+
+const DiskRecordStore::IndexEntry &DiskRecordStore::entry(int row) const
+{
+    return reinterpret_cast<const IndexEntry*>(index_)[firstEntry_ + row];
+}
+
+DiskRecordStore::IndexEntry &DiskRecordStore::entry(int row)
+{
+    return reinterpret_cast<IndexEntry*>(index_)[firstEntry_ + row];
+}
+
+bool DiskRecordStore::reserve(QFile *file, uchar **data, qint64 *capacity, qint64 size)
+{
+    if (size <= *capacity)
+        return true;
+
+    qint64 newCapacity = qMax<qint64>(*capacity, 4096);
+    while (newCapacity < size)
+        newCapacity *= 2;
+
+    return remap(file, data, capacity, newCapacity);
+}
+
+bool DiskRecordStore::remap(QFile *file, uchar **data, qint64 *capacity, qint64 newCapacity)
+{
+    // Old mapping is kept until new one is ready so store stays readable on error.
+    if ( newCapacity > *capacity && !file->resize(newCapacity) ) {
+        errorString_ = QObject::tr("Cannot resize file \"%1\": %2")
+                .arg( file->fileName() ).arg( file->errorString() );
+        file->resize(*capacity);
+        return false;
+    }
+
+    uchar *newData = file->map(0, newCapacity);
+    if (newData == nullptr) {
+        errorString_ = QObject::tr("Cannot map file \"%1\": %2")
+                .arg( file->fileName() ).arg( file->errorString() );
+        if (newCapacity > *capacity)
+            file->resize(*capacity);
+        return false;
+    }
+
+    if (*data != nullptr)
+        file->unmap(*data);
+    *data = newData;
+
+    if (newCapacity < *capacity)
+        file->resize(newCapacity);
+
+    *capacity = newCapacity;
+    return true;
+}
+
+void DiskRecordStore::compact(int liveCount)
+{
+    const qint64 dataStart = liveCount > 0 ? entry(0).offset : dataSize_;
+
+    memmove( data_, data_ + dataStart, dataSize_ - dataStart );
+    dataSize_ -= dataStart;
+
+    IndexEntry *entries = reinterpret_cast<IndexEntry*>(index_);
+    memmove( entries, entries + firstEntry_, liveCount * sizeof(IndexEntry) );
+    for (int i = 0; i < liveCount; ++i)
+        entries[i].offset -= dataStart;
+    indexSize_ = liveCount * sizeof(IndexEntry);
+    firstEntry_ = 0;
+
+    // Release space if files are mostly unused (failure only keeps files larger).
+    if (dataCapacity_ > initialDataCapacity && dataCapacity_ > 4 * dataSize_) {
+        const qint64 capacity = qMax(initialDataCapacity, roundToPage(2 * dataSize_));
+        remap(dataFile_.get(), &data_, &dataCapacity_, capacity);
+    }
+
+    const qint64 initialIndexCapacity = initialIndexEntries * sizeof(IndexEntry);
+    if (indexCapacity_ > initialIndexCapacity && indexCapacity_ > 4 * indexSize_) {
+        const qint64 capacity = qMax(initialIndexCapacity, roundToPage(2 * indexSize_));
+        remap(indexFile_.get(), &index_, &indexCapacity_, capacity);
+    }
+}
+
+void DiskRecordStore::close()
+{
+    if (dataFile_ != nullptr) {
+        if (data_ != nullptr)
+            dataFile_->unmap(data_);
+        dataFile_->resize(dataSize_);
+    }
+
+    if (indexFile_ != nullptr) {
+        if (index_ != nullptr)
+            indexFile_->unmap(index_);
+        indexFile_->resize(indexSize_);
+    }
+
+    dataFile_.reset();
+    indexFile_.reset();
+    data_ = index_ = nullptr;
+    dataSize_ = dataCapacity_ = 0;
+    indexSize_ = indexCapacity_ = 0;
+    firstEntry_ = 0;
+}
+
+} // namespace traypost
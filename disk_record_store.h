@@ -0,0 +1,107 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "record_store.h"
+
+#include <QString>
+
+#include <memory>
+
+class QFile;
+
+namespace traypost {
+
+/**
+ * Keeps records in memory-mapped files.
+ *
+ * Record texts (UTF-8) are appended to data file and fixed-size entries with
+ * text offset and time are appended to index file ("<data file>.idx") so
+ * any record can be read in constant time.
+ *
+ * Evicted records are skipped until they take more space than the remaining
+ * ones; remaining records are then moved to the beginning of the files and
+ * mostly unused space is released.
+ */
+class DiskRecordStore : public RecordStore
+{
+public:
+    DiskRecordStore();
+
+    ~DiskRecordStore();
+
+    /**
+     * Create data and index files (temporary files if @a path is empty).
+     * Existing files are overwritten.
+     */
+    bool open(const QString &path);
+
+    QString errorString() const { return errorString_; }
+
+protected:
+    qint64 appendRecord(const Record &record);
+
+    qint64 removeFirstRecord();
+
+    void addRepeats(int row, int count, qint64 lastSeen);
+
+    Record recordAt(int row) const;
+
+    qint64 recordTime(int row) const;
+
+private:
+    struct IndexEntry;
+
+    const IndexEntry &entry(int row) const;
+
+    IndexEntry &entry(int row);
+
+    bool reserve(QFile *file, uchar **data, qint64 *capacity, qint64 size);
+
+    /**
+     * Resize file and map it again (keeps old mapping on error).
+     */
+    bool remap(QFile *file, uchar **data, qint64 *capacity, qint64 newCapacity);
+
+    /**
+     * Move @a liveCount records after removed ones to beginning of files.
+     */
+    void compact(int liveCount);
+
+    void close();
+
+    std::unique_ptr<QFile> dataFile_;
+    std::unique_ptr<QFile> indexFile_;
+
+    uchar *data_;
+    qint64 dataSize_;
+    qint64 dataCapacity_;
+
+    uchar *index_;
+    qint64 indexSize_;
+    qint64 indexCapacity_;
+    /// Index entry of first record.
+    qint64 firstEntry_;
+
+    QString errorString_;
+    bool errorReported_;
+};
+
+} // namespace traypost
@@ -0,0 +1,385 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "icon_renderer.h"
+
+#if QT_VERSION < 0x050000
+#   include <QIconEngineV2>
+#else
+#   include <QIconEngine>
+#endif
+#include <QFontMetrics>
+#include <QMap>
+#include <QPainter>
+#include <QPixmap>
+#include <QVector>
+
+namespace traypost {
+
+namespace {
+
+#if QT_VERSION < 0x050000
+typedef QIconEngineV2 IconEngineBase;
+#else
+typedef QIconEngine IconEngineBase;
+#endif
+
+int horizontalAdvance(const QFontMetrics &fm, QChar c)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    return fm.horizontalAdvance(c);
+#else
+    return fm.width(c);
+#endif
+}
+
+/// Number of cached icons (one for each text).
+constexpr int iconCacheSize = 64;
+
+/// Width of text outline.
+constexpr int outlineWidth = 2;
+
+const QString atlasCharacters = QString("0123456789");
+
+qint64 sizeKey(const QSize &size)
+{
+    return (static_cast<qint64>( size.width() ) << 32) | static_cast<quint32>( size.height() );
+}
+
+bool isAtlasText(const QString &text)
+{
+    for (const QChar &c : text) {
+        if ( !atlasCharacters.contains(c) )
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * Renders pixmaps for given base icon and text style.
+ *
+ * Style cannot be changed so icons created earlier keep their look.
+ */
+class IconPainter
+{
+public:
+    IconPainter(const QIcon &icon, const QFont &font, const QColor &color,
+                const QColor &outlineColor)
+        : icon_(icon)
+        , font_(font)
+        , color_(color)
+        , outlineColor_(outlineColor)
+        , fm_(font)
+        , atlasRowHeight_(0)
+    {
+    }
+
+    const QIcon &icon() const { return icon_; }
+    const QFont &font() const { return font_; }
+    const QColor &color() const { return color_; }
+    const QColor &outlineColor() const { return outlineColor_; }
+
+    QPixmap pixmap(const QString &text, const QSize &size)
+    {
+        QPixmap pix = basePixmap(size);
+        if ( pix.isNull() || text.isEmpty() )
+            return pix;
+
+        QPainter p(&pix);
+
+        // text position
+        const bool useAtlas = isAtlasText(text);
+        const int textWidth = useAtlas ? atlasTextWidth(text)
+                                       : fm_.size(Qt::TextSingleLine, text).width();
+        const int x = ( pix.width() - textWidth ) / 2;
+        const int y = ( pix.height() + fm_.height() ) / 2 - fm_.descent();
+
+        if (useAtlas)
+            drawAtlasText(&p, x, y, text);
+        else
+            drawText(&p, x, y, text);
+
+        return pix;
+    }
+
+    QList<QSize> availableSizes() const
+    {
+        return icon_.availableSizes();
+    }
+
+private:
+    struct Glyph {
+        /// Glyph outline in atlas (fill is one row below).
+        QRect rect;
+        /// Offset of the glyph origin in rect.
+        QPoint origin;
+        int advance;
+    };
+
+    /**
+     * Return icon pixmap of given size (scaled if the size is not available).
+     */
+    QPixmap basePixmap(const QSize &size)
+    {
+        const qint64 key = sizeKey(size);
+        auto it = basePixmaps_.constFind(key);
+        if ( it != basePixmaps_.constEnd() )
+            return *it;
+
+        QPixmap pix;
+        auto sizes = icon_.availableSizes();
+        if ( sizes.contains(size) || sizes.isEmpty() ) {
+            pix = icon_.pixmap(size);
+        } else {
+            QSize fromSize = sizes.first();
+            for (const QSize &availableSize : sizes) {
+                if ( availableSize.width() >= size.width() && availableSize.height() >= size.height() ) {
+                    fromSize = availableSize;
+                    break;
+                }
+            }
+            pix = icon_.pixmap(fromSize).scaled(size);
+        }
+
+        basePixmaps_.insert(key, pix);
+        return pix;
+    }
+
+    void drawText(QPainter *p, int x, int y, const QString &text)
+    {
+        // Draw text outline.
+        QPainterPath path;
+        path.addText(x, y, font_, text);
+        p->setPen(QPen(outlineColor_, outlineWidth));
+        p->setBrush(outlineColor_);
+        p->drawPath(path);
+
+        // Draw text.
+        p->setFont(font_);
+        p->setPen(color_);
+        p->drawText(x, y, text);
+    }
+
+    int atlasTextWidth(const QString &text)
+    {
+        buildAtlas();
+
+        int width = 0;
+        for (const QChar &c : text)
+            width += glyphs_[atlasCharacters.indexOf(c)].advance;
+        return width;
+    }
+
+    /**
+     * Compose text from pre-rendered glyphs; outlines are drawn first so they
+     * don't cover neighbouring glyphs.
+     */
+    void drawAtlasText(QPainter *p, int x, int y, const QString &text)
+    {
+        buildAtlas();
+
+        for (int row = 0; row < 2; ++row) {
+            int glyphX = x;
+            for (const QChar &c : text) {
+                const Glyph &glyph = glyphs_[atlasCharacters.indexOf(c)];
+                QRect source = glyph.rect.translated(0, row * atlasRowHeight_);
+                p->drawPixmap( QPoint(glyphX, y) - glyph.origin, atlas_, source );
+                glyphX += glyph.advance;
+            }
+        }
+    }
+
+    void buildAtlas()
+    {
+        if ( !atlas_.isNull() )
+            return;
+
+        const int pad = outlineWidth;
+        atlasRowHeight_ = fm_.height() + 2 * pad;
+
+        int atlasWidth = 0;
+        glyphs_.clear();
+        for (const QChar &c : atlasCharacters) {
+            Glyph glyph;
+            glyph.advance = horizontalAdvance(fm_, c);
+            const int left = pad + qMax(0, -fm_.leftBearing(c));
+            const int right = pad + qMax(0, -fm_.rightBearing(c));
+            glyph.origin = QPoint( left, pad + fm_.ascent() );
+            glyph.rect = QRect( atlasWidth, 0, left + glyph.advance + right, atlasRowHeight_ );
+            atlasWidth += glyph.rect.width();
+            glyphs_.append(glyph);
+        }
+
+        atlas_ = QPixmap(atlasWidth, 2 * atlasRowHeight_);
+        atlas_.fill(Qt::transparent);
+
+        QPainter p(&atlas_);
+        for (int i = 0; i < atlasCharacters.size(); ++i) {
+            const Glyph &glyph = glyphs_[i];
+            const QString c = atlasCharacters.mid(i, 1);
+            const QPoint origin = glyph.rect.topLeft() + glyph.origin;
+
+            QPainterPath path;
+            path.addText(origin, font_, c);
+            p.setPen(QPen(outlineColor_, outlineWidth));
+            p.setBrush(outlineColor_);
+            p.drawPath(path);
+
+            p.setFont(font_);
+            p.setPen(color_);
+            p.drawText( origin + QPoint(0, atlasRowHeight_), c );
+        }
+    }
+
+    QIcon icon_;
+    QFont font_;
+    QColor color_;
+    QColor outlineColor_;
+    QFontMetrics fm_;
+
+    QMap<qint64, QPixmap> basePixmaps_;
+
+    QPixmap atlas_;
+    int atlasRowHeight_;
+    QVector<Glyph> glyphs_;
+};
+
+namespace {
+
+/**
+ * Icon engine which renders pixmaps with text only when requested.
+ */
+class TextIconEngine : public IconEngineBase
+{
+public:
+    TextIconEngine(const std::shared_ptr<IconPainter> &painter, const QString &text,
+                   const QSize &currentSize)
+        : painter_(painter)
+        , text_(text)
+        , sizes_( painter->availableSizes() )
+    {
+        if ( !currentSize.isEmpty() && !sizes_.contains(currentSize) )
+            sizes_.append(currentSize);
+    }
+
+    void paint(QPainter *painter, const QRect &rect, QIcon::Mode mode, QIcon::State state)
+    {
+        painter->drawPixmap( rect, pixmap(rect.size(), mode, state) );
+    }
+
+    QPixmap pixmap(const QSize &size, QIcon::Mode, QIcon::State)
+    {
+        const qint64 key = sizeKey(size);
+        auto it = pixmaps_.constFind(key);
+        if ( it != pixmaps_.constEnd() )
+            return *it;
+
+        const QPixmap pix = painter_->pixmap(text_, size);
+        pixmaps_.insert(key, pix);
+        return pix;
+    }
+
+    IconEngineBase *clone() const
+    {
+        return new TextIconEngine(*this);
+    }
+
+#if QT_VERSION < 0x050000
+    void virtual_hook(int id, void *data)
+    {
+        if (id == QIconEngineV2::AvailableSizesHook) {
+            auto arg = reinterpret_cast<QIconEngineV2::AvailableSizesArgument*>(data);
+            arg->sizes = sizes_;
+        } else {
+            QIconEngineV2::virtual_hook(id, data);
+        }
+    }
+#else
+    QList<QSize> availableSizes(QIcon::Mode, QIcon::State) const
+    {
+        return sizes_;
+    }
+#endif
+
+private:
+    std::shared_ptr<IconPainter> painter_;
+    QString text_;
+    QList<QSize> sizes_;
+    QMap<qint64, QPixmap> pixmaps_;
+};
+
+} // namespace
+
+IconRenderer::IconRenderer()
+    : painter_( new IconPainter(QIcon(), QFont(), Qt::black, Qt::white) )
+    , icons_(iconCacheSize)
+    , currentSize_()
+{
+}
+
+IconRenderer::~IconRenderer()
+{
+}
+
+void IconRenderer::setIcon(const QIcon &icon)
+{
+    painter_.reset( new IconPainter(icon, painter_->font(), painter_->color(),
+                                    painter_->outlineColor()) );
+    reset();
+}
+
+void IconRenderer::setTextStyle(const QFont &font, const QColor &color, const QColor &outlineColor)
+{
+    painter_.reset( new IconPainter(painter_->icon(), font, color, outlineColor) );
+    reset();
+}
+
+QIcon IconRenderer::icon(const QString &text, const QSize &currentSize)
+{
+    if (currentSize != currentSize_) {
+        reset();
+        currentSize_ = currentSize;
+    }
+
+    QIcon *cachedIcon = icons_.object(text);
+    if (cachedIcon != nullptr)
+        return *cachedIcon;
+
+    auto engine = new TextIconEngine(painter_, text, currentSize);
+    if ( !currentSize.isEmpty() )
+        engine->pixmap(currentSize, QIcon::Normal, QIcon::Off);
+
+    QIcon icon(engine);
+    icons_.insert( text, new QIcon(icon) );
+    return icon;
+}
+
+QPixmap IconRenderer::pixmap(const QString &text, const QSize &size)
+{
+    return painter_->pixmap(text, size);
+}
+
+void IconRenderer::reset()
+{
+    icons_.clear();
+}
+
+} // namespace traypost
@@ -0,0 +1,79 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QCache>
+#include <QIcon>
+#include <QSize>
+
+#include <memory>
+
+class QColor;
+class QFont;
+
+namespace traypost {
+
+class IconPainter;
+
+/**
+ * Renders tray icon with text.
+ *
+ * Digits are pre-rendered (with outline) once per text style and pixmaps are
+ * composed from these. Icons for recently used texts are cached.
+ */
+class IconRenderer
+{
+public:
+    IconRenderer();
+
+    ~IconRenderer();
+
+    /**
+     * Set base icon.
+     */
+    void setIcon(const QIcon &icon);
+
+    /**
+     * Set text font, text color and text outline color.
+     */
+    void setTextStyle(const QFont &font, const QColor &color, const QColor &outlineColor);
+
+    /**
+     * Return icon with text.
+     *
+     * Only pixmap of @a currentSize is rendered immediately, pixmaps of other
+     * sizes are rendered when requested.
+     */
+    QIcon icon(const QString &text, const QSize &currentSize);
+
+    /**
+     * Render icon pixmap with text.
+     */
+    QPixmap pixmap(const QString &text, const QSize &size);
+
+private:
+    void reset();
+
+    std::shared_ptr<IconPainter> painter_;
+    QCache<QString, QIcon> icons_;
+    QSize currentSize_;
+};
+
+} // namespace traypost
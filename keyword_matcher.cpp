@@ -0,0 +1,166 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "keyword_matcher.h"
+
+#include <QMap>
+#include <QQueue>
+
+#include <algorithm>
+
+namespace traypost {
+
+namespace {
+
+ushort foldCase(QChar c)
+{
+    return c.toCaseFolded().unicode();
+}
+
+} // namespace
+
+KeywordMatcher::KeywordMatcher()
+    : nodes_()
+    , edges_()
+{
+}
+
+KeywordMatcher::KeywordMatcher(const QStringList &keywords)
+    : nodes_()
+    , edges_()
+{
+    build(keywords);
+}
+
+QVector<TextSpan> KeywordMatcher::find(const QString &text) const
+{
+    QVector<TextSpan> spans;
+    if ( isEmpty() )
+        return spans;
+
+    int state = 0;
+    for (int i = 0; i < text.size(); ++i) {
+        const ushort c = foldCase(text[i]);
+
+        int next = transition(state, c);
+        while (next == -1 && state != 0) {
+            state = nodes_[state].fail;
+            next = transition(state, c);
+        }
+        state = next == -1 ? 0 : next;
+
+        const int length = nodes_[state].matchLength;
+        if (length == 0)
+            continue;
+
+        // Merge with previous spans if overlapping or adjacent.
+        int start = i + 1 - length;
+        while ( !spans.isEmpty() && spans.last().start + spans.last().length >= start ) {
+            start = qMin(start, spans.last().start);
+            spans.removeLast();
+        }
+
+        TextSpan span;
+        span.start = start;
+        span.length = i + 1 - start;
+        spans.append(span);
+    }
+
+    return spans;
+}
+
+int KeywordMatcher::transition(int node, ushort c) const
+{
+    const Node &n = nodes_[node];
+    const Edge *begin = edges_.constData() + n.firstEdge;
+    const Edge *end = begin + n.edgeCount;
+    const Edge *it = std::lower_bound(begin, end, c, [](const Edge &edge, ushort value) {
+        return edge.c < value;
+    });
+    return it != end && it->c == c ? it->target : -1;
+}
+
+void KeywordMatcher::build(const QStringList &keywords)
+{
+    // Build trie with ordered transitions.
+    QVector< QMap<ushort, int> > children(1);
+    QVector<int> lengths(1, 0);
+
+    for (const auto &keyword : keywords) {
+        if ( keyword.isEmpty() )
+            continue;
+
+        int node = 0;
+        for (const QChar &ch : keyword) {
+            const ushort c = foldCase(ch);
+            const int child = children[node].value(c, -1);
+            if (child != -1) {
+                node = child;
+            } else {
+                children[node].insert(c, children.size());
+                node = children.size();
+                children.append( QMap<ushort, int>() );
+                lengths.append(0);
+            }
+        }
+        lengths[node] = keyword.size();
+    }
+
+    nodes_.resize( children.size() );
+    edges_.clear();
+    for (int i = 0; i < children.size(); ++i) {
+        Node &node = nodes_[i];
+        node.firstEdge = edges_.size();
+        node.edgeCount = children[i].size();
+        node.fail = 0;
+        node.matchLength = lengths[i];
+        for (auto it = children[i].constBegin(); it != children[i].constEnd(); ++it) {
+            Edge edge;
+            edge.c = it.key();
+            edge.target = it.value();
+            edges_.append(edge);
+        }
+    }
+
+    // Compute failure links in breadth-first order so suffix states are done first.
+    QQueue<int> queue;
+    for (int e = 0; e < nodes_[0].edgeCount; ++e)
+        queue.enqueue(edges_[nodes_[0].firstEdge + e].target);
+
+    while ( !queue.isEmpty() ) {
+        const int node = queue.dequeue();
+        for (int e = 0; e < nodes_[node].edgeCount; ++e) {
+            const Edge edge = edges_[nodes_[node].firstEdge + e];
+
+            int fail = nodes_[node].fail;
+            int next = transition(fail, edge.c);
+            while (next == -1 && fail != 0) {
+                fail = nodes_[fail].fail;
+                next = transition(fail, edge.c);
+            }
+
+            Node &child = nodes_[edge.target];
+            child.fail = next == -1 ? 0 : next;
+            child.matchLength = qMax( child.matchLength, nodes_[child.fail].matchLength );
+            queue.enqueue(edge.target);
+        }
+    }
+}
+
+} // namespace traypost
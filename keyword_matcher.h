@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "record.h"
+
+#include <QStringList>
+#include <QVector>
+
+namespace traypost {
+
+/**
+ * Finds all occurrences of many keywords (case-insensitive) in single pass
+ * over text using Aho-Corasick automaton.
+ *
+ * Matching is thread-safe.
+ */
+class KeywordMatcher
+{
+public:
+    KeywordMatcher();
+
+    explicit KeywordMatcher(const QStringList &keywords);
+
+    bool isEmpty() const { return nodes_.size() <= 1; }
+
+    /**
+     * Return sorted non-overlapping parts of text covered by keywords.
+     */
+    QVector<TextSpan> find(const QString &text) const;
+
+private:
+    struct Node {
+        /// Range of outgoing transitions in edges_.
+        int firstEdge;
+        int edgeCount;
+        /// Longest state which is proper suffix of this state.
+        int fail;
+        /// Length of longest keyword which is suffix of this state (0 if none).
+        int matchLength;
+    };
+
+    struct Edge {
+        ushort c;
+        int target;
+    };
+
+    /**
+     * Return next state from @a node for character or -1 if trie has no such
+     * transition.
+     */
+    int transition(int node, ushort c) const;
+
+    void build(const QStringList &keywords);
+
+    QVector<Node> nodes_;
+    /// Transitions of each node sorted by character.
+    QVector<Edge> edges_;
+};
+
+} // namespace traypost
@@ -20,18 +20,41 @@
 #include "launcher.h"
 #include "tray.h"
 #include "console_reader.h"
+#include "message_format.h"
+#include "post_client.h"
 
 #include <QApplication>
 #include <QEvent>
+#include <QFile>
+#include <QSocketNotifier>
 #include <QThread>
 #include <iostream>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
 #define VERSION "0.0.1"
 
 namespace traypost {
 
 namespace {
 
+/// Pipe for passing signal numbers from signal handler to event loop.
+int signalPipe[2] = {-1, -1};
+
+void signalHandler(int signal)
+{
+    const int savedErrno = errno;
+    const char c = static_cast<char>(signal);
+    if ( ::write(signalPipe[1], &c, 1) == -1 ) {
+        // Pipe is full so exit is already pending.
+    }
+    errno = savedErrno;
+}
+
 class Arguments {
 public:
     Arguments(const QStringList &arguments)
@@ -66,7 +89,7 @@ public:
             }
 
             ++index_;
-        } else if ( arg.startsWith("-") ) {
+        } else if ( arg.startsWith("-") && arg.size() > 1 ) {
             ++argIndex_;
             name_ = QString(QChar('-')) + arg.mid(argIndex_, 1);
             if ( argIndex_ + 1 == arg.size() ) {
@@ -82,6 +105,11 @@ public:
 
     const QString getName() const { return name_; }
 
+    /**
+     * Return true if value was passed with option name (i.e. "--option=value").
+     */
+    bool hasValue() const { return !value_.isNull(); }
+
     const QString fetchValue()
     {
         if (value_.isNull()) {
@@ -112,6 +140,26 @@ private:
     int argIndex_;
 };
 
+/**
+ * Return true if option needs value (must match option parsing in
+ * Launcher::start()).
+ */
+bool needsValue(const QString &name)
+{
+    static const QStringList options = QStringList()
+            << "-i" << "--icon" << "-t" << "--text" << "-T" << "--tooltip"
+            << "--timeout" << "--tooltip-lines" << "--icon-fps"
+            << "--max-records" << "--max-memory" << "--max-age" << "--log-file"
+            << "--stats-file" << "--batch-size" << "--batch-latency" << "--input"
+            << "--export-on-exit" << "--socket" << "--dedup-window"
+            << "--include" << "--exclude" << "--highlight" << "--input-format"
+            << "--notify-delay" << "--notify-max-delay" << "--notify-budget"
+            << "-c" << "--color" << "-o" << "--outline"
+            << "--warning-color" << "--error-color" << "-f" << "--font"
+            << "--time-format" << "--format";
+    return options.contains(name);
+}
+
 QFont fontFromString(const QString &fontDesc)
 {
     QFont font;
@@ -143,6 +191,24 @@ QFont fontFromString(const QString &fontDesc)
     return font;
 }
 
+/**
+ * Parse duration with optional unit suffix (s, m, h, d; default is seconds).
+ */
+bool parseDuration(const QString &value, qint64 *ms)
+{
+    QRegExp re("(\\d+)\\s*([smhd]?)");
+    if ( !re.exactMatch(value.trimmed()) )
+        return false;
+
+    static const QString units("smhd");
+    static const qint64 unitMs[] = {1000, 60 * 1000, 60 * 60 * 1000, 24 * 60 * 60 * 1000};
+    const QString unit = re.cap(2);
+    const int unitIndex = unit.isEmpty() ? 0 : units.indexOf(unit);
+
+    *ms = re.cap(1).toLongLong() * unitMs[unitIndex];
+    return true;
+}
+
 void error(const QString &msg, int exitCode = 0)
 {
     std::cerr << msg.toLocal8Bit().data() << std::endl;
@@ -170,21 +236,85 @@ void printHelp(const QString &program)
                + QObject::tr("Tray icon text color") );
     printLine( QString("  -o, --outline {color=white}   ")
                + QObject::tr("Tray icon text outline color") );
+    printLine( QString("  --warning-color {color=darkorange} ")
+               + QObject::tr("Tray icon text color if there are new warnings") );
+    printLine( QString("  --error-color {color=red}     ")
+               + QObject::tr("Tray icon text color if there are new errors") );
     printLine( QString("  -f, --font {font}             ")
                + QObject::tr("Tray icon text font (e.g. 'DejaVu Sans, 10, bold, underline')")
                + QString("\n                                ")
                + QObject::tr("Font options: italic, bold, overline, underline, strikeout") );
     printLine( QString("  -T, --tooltip {tooltip text}  ")
                + QObject::tr("Tray icon default tool tip text") );
+    printLine( QString("  --tooltip-lines {count=10}    ")
+               + QObject::tr("Number of last new messages shown in tray icon tool tip") );
+    printLine( QString("  --icon-fps {fps=10}           ")
+               + QObject::tr("Maximum number of icon updates per second (0 for no limit)") );
     printLine();
     printLine( QString("  --timeout {milliseconds}      ")
                + QObject::tr("Message show timeout.") );
+    printLine( QString("  --notify-delay {ms=1000}      ")
+               + QObject::tr("Show notification after no new messages arrived for given time.") );
+    printLine( QString("  --notify-max-delay {ms=5000}  ")
+               + QObject::tr("Maximum delay of notification after new message.") );
+    printLine( QString("  --notify-budget {count=10}    ")
+               + QObject::tr("Maximum number of notifications per minute (0 for no limit).") );
     printLine( QString("  --format {format}     ")
                + QObject::tr("Format for messages (HTML; %1 is message, %2 is message time)")
                + QString("\n                                ")
                + QObject::tr("Example: '<p><small><b>%2</b></small><br />%1</p>'") );
     printLine( QString("  --time-format {format}        ")
                + QObject::tr("Time format for messages (e.g. 'dd.MM.yyyy hh:mm:ss.zzz')") );
+    printLine( QString("  --highlight {keywords}        ")
+               + QObject::tr("Show comma-separated keywords in bold (case-insensitive).") );
+    printLine();
+    printLine( QString("  --max-records {count}         ")
+               + QObject::tr("Maximum number of records kept in log.") );
+    printLine( QString("  --max-memory {MiB}            ")
+               + QObject::tr("Maximum memory taken by records kept in log (including search index).") );
+    printLine( QString("  --max-age {duration}          ")
+               + QObject::tr("Remove records older than given time (e.g. '90s', '30m', '12h', '7d').") );
+    printLine();
+    printLine( QString("  --log-file {file name}        ")
+               + QObject::tr("Keep records in given file instead of memory (file is overwritten).") );
+    printLine( QString("  --disk-log                    ")
+               + QObject::tr("Keep records in temporary file instead of memory.") );
+    printLine( QString("  --export-on-exit {file name}  ")
+               + QObject::tr("Export log at exit (format by suffix: '.jsonl', '.csv', otherwise plain text).") );
+    printLine();
+    printLine( QString("  --input {file name}           ")
+               + QObject::tr("Read lines from file, FIFO or Unix socket instead of stdin ('-').")
+               + QString("\n                                ")
+               + QObject::tr("Can be used multiple times; new records from each input are counted.") );
+    printLine( QString("  --daemon                      ")
+               + QObject::tr("Read lines posted to Unix socket (instead of stdin if no --input is used).") );
+    printLine( QString("  --socket {file name}          ")
+               + QObject::tr("Daemon socket (default is '$XDG_RUNTIME_DIR/traypost.sock').") );
+    printLine( QString("  --post {message}              ")
+               + QObject::tr("Post message to running daemon and exit ('-' posts stdin).") );
+    printLine( QString("  --batch-size {lines=1000}     ")
+               + QObject::tr("Maximum number of input lines processed at once.") );
+    printLine( QString("  --batch-latency {ms=50}       ")
+               + QObject::tr("Maximum time to wait for more input lines before processing them.") );
+    printLine( QString("  --input-format {format=plain} ")
+               + QObject::tr("Parse message, level, time and source from lines in given format")
+               + QString("\n                                ")
+               + QObject::tr("('json' for JSON Lines, 'logfmt' or 'plain').") );
+    printLine( QString("  --include {pattern}           ")
+               + QObject::tr("Keep only lines containing text or matching '/regular expression/'.") );
+    printLine( QString("  --exclude {pattern}           ")
+               + QObject::tr("Drop lines containing text or matching '/regular expression/'.")
+               + QString("\n                                ")
+               + QObject::tr("Both can be used multiple times; lines are filtered in reader thread.") );
+    printLine( QString("  --fold-repeats                ")
+               + QObject::tr("Show consecutive identical lines as single record with repeat count.") );
+    printLine( QString("  --dedup-window {lines}        ")
+               + QObject::tr("Drop lines identical to any of given number of previous lines.") );
+    printLine();
+    printLine( QString("  --stats[={duration=1s}]       ")
+               + QObject::tr("Print statistics as JSON lines periodically to stderr.") );
+    printLine( QString("  --stats-file {file name}      ")
+               + QObject::tr("Append statistics to given file instead of stderr.") );
     printLine();
     printLine( QString("  --record-end  ")
                + QObject::tr("Record end of stdin.") );
@@ -193,7 +323,9 @@ void printHelp(const QString &program)
     printLine( QString("  --select      ")
                + QObject::tr("Open log dialog and exit after item is selected (exit code is 0) or")
                + QString("\n                ")
-               + QObject::tr("dialog is closed without any selection (exit code is 1).") );
+               + QObject::tr("dialog is closed without any selection (exit code is 1).")
+               + QString("\n                ")
+               + QObject::tr("Search is fuzzy with best matches first.") );
     printLine();
     printLine( QString("TrayPost Desktop Tray Notifier " VERSION " (hluk@email.cz)") );
     exit(0);
@@ -201,9 +333,30 @@ void printHelp(const QString &program)
 
 } // namespace
 
+bool hasPostOption(int argc, char *argv[])
+{
+    QStringList arguments;
+    for (int i = 0; i < argc; ++i)
+        arguments.append( QString::fromLocal8Bit(argv[i]) );
+
+    Arguments args(arguments);
+    while ( args.next() ) {
+        const QString &name = args.getName();
+        if (name == "--post")
+            return true;
+        if ( needsValue(name) )
+            args.fetchValue();
+    }
+
+    return false;
+}
+
 Launcher::Launcher()
     : tray_(nullptr)
     , reader_( new traypost::ConsoleReader() )
+    , readerThread_(nullptr)
+    , socketPath_()
+    , signalNotifier_(nullptr)
 {
     readerThread_ = new QThread();
     reader_->moveToThread(readerThread_);
@@ -222,6 +375,9 @@ Launcher::~Launcher()
         readerThread_->deleteLater();
         readerThread_ = nullptr;
     }
+
+    if ( !socketPath_.isEmpty() )
+        QFile::remove(socketPath_);
 }
 
 void Launcher::start()
@@ -231,6 +387,8 @@ void Launcher::start()
     QString iconText;
     QColor textColor;
     QColor textOutlineColor;
+    QColor warningColor("darkorange");
+    QColor errorColor("red");
     QFont font = QApplication::font();
     QString timeFormat("dd.MM.yyyy hh:mm:ss.zzz");
     QString recordFormat("<p><small><b>%2</b></small><br />%1</p>");
@@ -238,6 +396,30 @@ void Launcher::start()
     bool recordEnd = false;
     bool selectMode = false;
     int timeout = 8000;
+    int iconFps = 10;
+    int toolTipLines = 10;
+    int notifyDelay = 1000;
+    int notifyMaxDelay = 5000;
+    int notifyBudget = 10;
+    int maxRecords = 0;
+    qint64 maxMemory = 0;
+    qint64 maxAge = 0;
+    QString logFile;
+    bool diskLog = false;
+    int batchSize = 1000;
+    int batchLatency = 50;
+    QStringList inputs;
+    QString exportOnExit;
+    bool daemon = false;
+    QString socketPath = QFile::decodeName( defaultSocketPath().c_str() );
+    bool foldRepeats = false;
+    int dedupWindow = 0;
+    traypost::InputFormat inputFormat = traypost::PlainInput;
+    traypost::LineFilter lineFilter;
+    QStringList highlights;
+    QString filterError;
+    qint64 statsInterval = 0;
+    QString statsFile;
 
     Arguments args( qApp->arguments() );
     while ( args.next() ) {
@@ -271,6 +453,137 @@ void Launcher::start()
             if (value.isNull() || !ok)
                 error( QObject::tr("Option %1 needs value in milliseconds.").arg(name), 2 );
             timeout = ms;
+        } else if (name == "--tooltip-lines") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int lines = value.toInt(&ok);
+            if (value.isNull() || !ok || lines <= 0)
+                error( QObject::tr("Option %1 needs positive number of lines.").arg(name), 2 );
+            toolTipLines = lines;
+        } else if (name == "--icon-fps") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int fps = value.toInt(&ok);
+            if (value.isNull() || !ok || fps < 0)
+                error( QObject::tr("Option %1 needs number of updates per second.").arg(name), 2 );
+            iconFps = fps;
+        } else if (name == "--max-records") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int count = value.toInt(&ok);
+            if (value.isNull() || !ok || count <= 0)
+                error( QObject::tr("Option %1 needs positive number of records.").arg(name), 2 );
+            maxRecords = count;
+        } else if (name == "--max-memory") {
+            auto &value = args.fetchValue();
+            bool ok;
+            qint64 mib = value.toLongLong(&ok);
+            if (value.isNull() || !ok || mib <= 0)
+                error( QObject::tr("Option %1 needs positive size in MiB.").arg(name), 2 );
+            maxMemory = mib * 1024 * 1024;
+        } else if (name == "--max-age") {
+            auto &value = args.fetchValue();
+            if ( value.isNull() || !parseDuration(value, &maxAge) || maxAge <= 0 )
+                error( QObject::tr("Option %1 needs positive duration.").arg(name), 2 );
+        } else if (name == "--log-file") {
+            auto &value = args.fetchValue();
+            if ( value.isEmpty() )
+                error( QObject::tr("Option %1 needs file name.").arg(name), 2 );
+            logFile = value;
+            diskLog = true;
+        } else if (name == "--stats") {
+            statsInterval = 1000;
+            if ( (args.hasValue() && !parseDuration(args.fetchValue(), &statsInterval))
+                 || statsInterval <= 0 )
+                error( QObject::tr("Option %1 needs positive duration.").arg(name), 2 );
+        } else if (name == "--stats-file") {
+            auto &value = args.fetchValue();
+            if (value.isNull())
+                error( QObject::tr("Option %1 needs file name.").arg(name), 2 );
+            statsFile = value;
+        } else if (name == "--disk-log") {
+            diskLog = true;
+        } else if (name == "--batch-size") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int lines = value.toInt(&ok);
+            if (value.isNull() || !ok || lines <= 0)
+                error( QObject::tr("Option %1 needs positive number of lines.").arg(name), 2 );
+            batchSize = lines;
+        } else if (name == "--batch-latency") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int ms = value.toInt(&ok);
+            if (value.isNull() || !ok || ms < 0)
+                error( QObject::tr("Option %1 needs value in milliseconds.").arg(name), 2 );
+            batchLatency = ms;
+        } else if (name == "--input") {
+            auto &value = args.fetchValue();
+            if (value.isNull())
+                error( QObject::tr("Option %1 needs file name.").arg(name), 2 );
+            inputs.append(value);
+        } else if (name == "--export-on-exit") {
+            auto &value = args.fetchValue();
+            if (value.isNull())
+                error( QObject::tr("Option %1 needs file name.").arg(name), 2 );
+            exportOnExit = value;
+        } else if (name == "--daemon") {
+            daemon = true;
+        } else if (name == "--socket") {
+            auto &value = args.fetchValue();
+            if (value.isNull())
+                error( QObject::tr("Option %1 needs file name.").arg(name), 2 );
+            socketPath = value;
+        } else if (name == "--fold-repeats") {
+            foldRepeats = true;
+        } else if (name == "--dedup-window") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int lines = value.toInt(&ok);
+            if (value.isNull() || !ok || lines <= 0)
+                error( QObject::tr("Option %1 needs positive number of lines.").arg(name), 2 );
+            dedupWindow = lines;
+        } else if (name == "--include" || name == "--exclude") {
+            auto &value = args.fetchValue();
+            if (value.isNull())
+                error( QObject::tr("Option %1 needs pattern.").arg(name), 2 );
+            const bool ok = name == "--include"
+                    ? lineFilter.addInclude(value, &filterError)
+                    : lineFilter.addExclude(value, &filterError);
+            if (!ok)
+                error(filterError, 2);
+        } else if (name == "--highlight") {
+            auto &value = args.fetchValue();
+            if (value.isNull())
+                error( QObject::tr("Option %1 needs comma-separated keywords.").arg(name), 2 );
+            highlights.append( value.split(',', QString::SkipEmptyParts) );
+        } else if (name == "--input-format") {
+            auto &value = args.fetchValue();
+            if (value == "json")
+                inputFormat = traypost::JsonInput;
+            else if (value == "logfmt")
+                inputFormat = traypost::LogfmtInput;
+            else if (value == "plain")
+                inputFormat = traypost::PlainInput;
+            else
+                error( QObject::tr("Option %1 needs value \"json\", \"logfmt\" or \"plain\".").arg(name), 2 );
+        } else if (name == "--notify-delay" || name == "--notify-max-delay") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int ms = value.toInt(&ok);
+            if (value.isNull() || !ok || ms < 0)
+                error( QObject::tr("Option %1 needs value in milliseconds.").arg(name), 2 );
+            if (name == "--notify-delay")
+                notifyDelay = ms;
+            else
+                notifyMaxDelay = ms;
+        } else if (name == "--notify-budget") {
+            auto &value = args.fetchValue();
+            bool ok;
+            int count = value.toInt(&ok);
+            if (value.isNull() || !ok || count < 0)
+                error( QObject::tr("Option %1 needs number of notifications.").arg(name), 2 );
+            notifyBudget = count;
         } else if (name == "-c" || name == "--color") {
             auto &value = args.fetchValue();
             if (value.isNull())
@@ -285,6 +598,14 @@ void Launcher::start()
             textOutlineColor = QColor(value);
             if ( !textOutlineColor.isValid() )
                 error( QObject::tr("Invalid color \"%1\".").arg(value) );
+        } else if (name == "--warning-color" || name == "--error-color") {
+            auto &value = args.fetchValue();
+            if (value.isNull())
+                error( QObject::tr("Option %1 needs text.").arg(name), 2 );
+            QColor &color = name == "--warning-color" ? warningColor : errorColor;
+            color = QColor(value);
+            if ( !color.isValid() )
+                error( QObject::tr("Invalid color \"%1\".").arg(value), 2 );
         } else if (name == "-f" || name == "--font") {
             auto &value = args.fetchValue();
             if (value.isNull())
@@ -319,25 +640,91 @@ void Launcher::start()
         textOutlineColor = Qt::white;
 
     tray_ = new traypost::Tray();
+    // Record store must be set up before first record is added.
+    QString errorString;
+    if ( diskLog && !tray_->setLogFile(logFile, &errorString) )
+        error(errorString, 2);
+    tray_->setRecordLimits(maxRecords, maxMemory, maxAge);
+    tray_->setToolTipLines(toolTipLines);
     if ( !toolTip.isNull() )
         tray_->setToolTip(toolTip);
     tray_->setMessageTimeout(timeout);
+    tray_->setNotificationLimits(notifyDelay, notifyMaxDelay, notifyBudget);
+    tray_->setIconFps(iconFps);
     tray_->setIcon(icon);
     tray_->setIconText(iconText);
     tray_->setIconTextStyle(font, textColor, textOutlineColor);
-    tray_->setTimeFormat(timeFormat);
-    tray_->setMessageFormat(recordFormat);
+    tray_->setLevelColors(warningColor, errorColor);
+    tray_->setMessageFormat( MessageFormat(recordFormat, timeFormat) );
     tray_->setRecordInputEnd(recordEnd);
     tray_->setSelectMode(selectMode);
+    tray_->setExportOnExit(exportOnExit);
+    if ( statsInterval > 0 && !tray_->setStatisticsReport(statsInterval, statsFile) )
+        error( QObject::tr("Cannot open statistics file \"%1\".").arg(statsFile), 2 );
     tray_->show();
     if (showLog || selectMode)
         tray_->showLog();
 
+    for (const auto &input : inputs) {
+        if ( !reader_->openInput(input, &errorString) )
+            error(errorString, 2);
+    }
+    if (daemon) {
+        if ( !reader_->listen(socketPath, &errorString) )
+            error(errorString, 2);
+        socketPath_ = socketPath;
+    }
+    tray_->setInputSources( reader_->inputNames() );
+
+    reader_->setBatchSize(batchSize);
+    reader_->setBatchLatency(batchLatency);
+    reader_->setFoldRepeats(foldRepeats);
+    reader_->setDedupWindow(dedupWindow);
+    reader_->setInputFormat(inputFormat);
+    reader_->setLineFilter(lineFilter);
+    reader_->setHighlighter( traypost::KeywordMatcher(highlights) );
+
+    connect( reader_, SIGNAL(sourcesChanged(QStringList)), tray_, SLOT(setInputSources(QStringList)) );
     connect( reader_, SIGNAL(finished()), tray_, SLOT(onInputEnd()) );
-    connect( reader_, SIGNAL(newLine(QString)), tray_, SLOT(onInputLine(QString)) );
-    connect( tray_, SIGNAL(readLine()), reader_, SLOT(readLines()) );
+    connect( reader_, SIGNAL(repeated(int,qint64)), tray_, SLOT(onInputRepeated(int,qint64)) );
+    connect( reader_, SIGNAL(newRecords(QVector<traypost::Record>)),
+             tray_, SLOT(onInputRecords(QVector<traypost::Record>)) );
+    // Reader thread is blocked in readLines() so this must be a direct call.
+    connect( tray_, SIGNAL(inputProcessed()), reader_, SLOT(releaseBatch()),
+             Qt::DirectConnection );
+
+    handleSignals();
 
     readerThread_->start();
 }
 
+void Launcher::onSignal()
+{
+    char c;
+    if ( ::read(signalPipe[0], &c, 1) != 1 )
+        return;
+
+    tray_->exit(128 + c);
+}
+
+void Launcher::handleSignals()
+{
+    if ( ::pipe2(signalPipe, O_CLOEXEC | O_NONBLOCK) != 0 ) {
+        error( QObject::tr("Cannot create pipe for signals: %1")
+               .arg( QString::fromLocal8Bit(strerror(errno)) ) );
+        return;
+    }
+
+    signalNotifier_ = new QSocketNotifier(signalPipe[0], QSocketNotifier::Read, this);
+    connect( signalNotifier_, SIGNAL(activated(int)), this, SLOT(onSignal()) );
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
 } // namespace traypost
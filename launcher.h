@@ -20,7 +20,9 @@
 #pragma once
 
 #include <QObject>
+#include <QString>
 
+class QSocketNotifier;
 class QThread;
 
 namespace traypost {
@@ -28,6 +30,12 @@ namespace traypost {
 class Tray;
 class ConsoleReader;
 
+/**
+ * Return true if command line contains "--post" option (and not just as value
+ * of other option).
+ */
+bool hasPostOption(int argc, char *argv[]);
+
 class Launcher : public QObject
 {
     Q_OBJECT
@@ -39,10 +47,21 @@ public:
 public slots:
     void start();
 
+private slots:
+    void onSignal();
+
 private:
+    /**
+     * Exit cleanly (export log, remove daemon socket) on SIGINT and SIGTERM.
+     */
+    void handleSignals();
+
     Tray *tray_;
     ConsoleReader *reader_;
     QThread *readerThread_;
+    /// Daemon socket to remove at exit.
+    QString socketPath_;
+    QSocketNotifier *signalNotifier_;
 };
 
 } // namespace traypost
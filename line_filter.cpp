@@ -0,0 +1,240 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "line_filter.h"
+
+#include <QObject>
+#include <QTextCodec>
+
+#include <ctype.h>
+#include <string.h>
+
+namespace traypost {
+
+namespace {
+
+bool isAscii(const QString &text)
+{
+    for (const QChar &c : text) {
+        if (c.unicode() >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+bool isQuantifier(QChar c)
+{
+    return c == '?' || c == '*' || c == '+' || c == '{';
+}
+
+/**
+ * Skip quantifier at @a i (e.g. "{2,3}") and return index of its last character.
+ */
+int skipQuantifier(const QString &re, int i)
+{
+    if (re[i] == '{') {
+        const int end = re.indexOf('}', i);
+        return end == -1 ? re.size() - 1 : end;
+    }
+    return i;
+}
+
+/**
+ * Return longest ASCII literal which must be in any text matched by regular
+ * expression (empty if there is no such literal).
+ *
+ * Only literals outside groups are considered and alternation outside groups
+ * disables this completely.
+ */
+QByteArray requiredLiteral(const QString &re)
+{
+    QByteArray best;
+    QByteArray current;
+    int depth = 0;
+
+    for (int i = 0; i < re.size(); ++i) {
+        QChar c = re[i];
+        bool literal = false;
+
+        if (c == '\\') {
+            if (++i == re.size())
+                break;
+            c = re[i];
+            // Character classes (\d, \w), assertions (\b), back-references and
+            // character codes (\x41, \0101) end the literal.
+            literal = !c.isLetterOrNumber();
+            if (c == 'x' || c == 'u') {
+                for (int n = 0; n < 4 && i + 1 < re.size() && isxdigit(re[i + 1].toLatin1()); ++n)
+                    ++i;
+            } else if (c == '0') {
+                for (int n = 0; n < 3 && i + 1 < re.size() && re[i + 1] >= '0' && re[i + 1] <= '7'; ++n)
+                    ++i;
+            }
+        } else if (c == '[') {
+            // Skip character set ("]" right after "[" or "[^" is literal).
+            int j = i + 1;
+            if (j < re.size() && re[j] == '^')
+                ++j;
+            if (j < re.size() && re[j] == ']')
+                ++j;
+            for ( ; j < re.size() && re[j] != ']'; ++j ) {
+                if (re[j] == '\\')
+                    ++j;
+            }
+            i = j;
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')') {
+            --depth;
+        } else if (c == '|') {
+            if (depth == 0)
+                return QByteArray();
+        } else if ( isQuantifier(c) ) {
+            i = skipQuantifier(re, i);
+        } else {
+            literal = c != '.' && c != '^' && c != '$';
+        }
+
+        literal = literal && depth == 0 && c.unicode() < 0x80;
+
+        // Optional or repeated character ends the literal.
+        const bool quantified = i + 1 < re.size() && isQuantifier(re[i + 1]);
+        if (literal && (!quantified || re[i + 1] == '+'))
+            current.append( static_cast<char>(c.unicode()) );
+
+        if (!literal || quantified) {
+            if ( current.size() > best.size() )
+                best = current;
+            current.clear();
+        }
+    }
+
+    return current.size() > best.size() ? current : best;
+}
+
+} // namespace
+
+LineFilter::LineFilter()
+    : filters_()
+    , hasIncludes_(false)
+{
+}
+
+bool LineFilter::addInclude(const QString &pattern, QString *errorString)
+{
+    return addFilter(pattern, false, errorString);
+}
+
+bool LineFilter::addExclude(const QString &pattern, QString *errorString)
+{
+    return addFilter(pattern, true, errorString);
+}
+
+QStringList LineFilter::patterns() const
+{
+    QStringList result;
+    for (const auto &filter : filters_)
+        result.append( (filter.exclude ? "-" : "+") + filter.pattern );
+    return result;
+}
+
+bool LineFilter::accepts(const char *data, int size, bool ascii, QTextCodec *codec, qint64 *hits) const
+{
+    QString text;
+    bool decoded = false;
+
+    for (int i = 0; i < filters_.size(); ++i) {
+        const Filter &filter = filters_[i];
+        if ( filter.exclude && matches(filter, data, size, ascii, codec, &text, &decoded) ) {
+            ++hits[i];
+            return false;
+        }
+    }
+
+    if (!hasIncludes_)
+        return true;
+
+    for (int i = 0; i < filters_.size(); ++i) {
+        const Filter &filter = filters_[i];
+        if ( !filter.exclude && matches(filter, data, size, ascii, codec, &text, &decoded) ) {
+            ++hits[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool LineFilter::addFilter(const QString &pattern, bool exclude, QString *errorString)
+{
+    Filter filter;
+    filter.pattern = pattern;
+    filter.exclude = exclude;
+    filter.literalOnly = false;
+
+    if ( pattern.size() >= 2 && pattern.startsWith('/') && pattern.endsWith('/') ) {
+        const QString re = pattern.mid(1, pattern.size() - 2);
+        filter.re = QRegExp(re);
+        if ( !filter.re.isValid() ) {
+            if (errorString != nullptr) {
+                *errorString = QObject::tr("Invalid regular expression \"%1\": %2")
+                        .arg(re, filter.re.errorString());
+            }
+            return false;
+        }
+        filter.literal = requiredLiteral(re);
+    } else if ( isAscii(pattern) ) {
+        // Locale encodings are ASCII compatible so bytes can be compared.
+        filter.literal = pattern.toLatin1();
+        filter.literalOnly = true;
+    } else {
+        filter.re = QRegExp(pattern, Qt::CaseSensitive, QRegExp::FixedString);
+    }
+
+    filters_.append(filter);
+    hasIncludes_ = hasIncludes_ || !exclude;
+    return true;
+}
+
+bool LineFilter::matches(const Filter &filter, const char *data, int size, bool ascii,
+                         QTextCodec *codec, QString *text, bool *decoded) const
+{
+    if ( !filter.literal.isEmpty()
+         && memmem(data, size, filter.literal.constData(), filter.literal.size()) == nullptr )
+    {
+        return false;
+    }
+
+    if (filter.literalOnly)
+        return true;
+
+    if (!*decoded) {
+        *decoded = true;
+        if (ascii)
+            *text = QString::fromLatin1(data, size);
+        else if (codec == nullptr)
+            *text = QString::fromUtf8(data, size);
+        else
+            *text = codec->toUnicode(data, size);
+    }
+
+    return filter.re.indexIn(*text) != -1;
+}
+
+} // namespace traypost
@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QRegExp>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QTextCodec;
+
+namespace traypost {
+
+/**
+ * Include and exclude filters for raw input lines.
+ *
+ * Pattern enclosed in slashes (e.g. "/error \d+/") is regular expression,
+ * other patterns are literal. Line is accepted if it matches no exclude
+ * filter and any include filter (if there are any).
+ *
+ * Lines are tested as raw bytes first with literal patterns or with literal
+ * required by regular expression so most rejected lines are never decoded.
+ *
+ * Matching is not thread-safe; each thread should use its own copy.
+ */
+class LineFilter
+{
+public:
+    LineFilter();
+
+    bool addInclude(const QString &pattern, QString *errorString = nullptr);
+
+    bool addExclude(const QString &pattern, QString *errorString = nullptr);
+
+    bool isEmpty() const { return filters_.isEmpty(); }
+
+    /**
+     * Return patterns with "+" (include) or "-" (exclude) prefix in order of
+     * hit counters.
+     */
+    QStringList patterns() const;
+
+    /**
+     * Return true if line passes the filters.
+     *
+     * Line is decoded only if needed, with @a codec (UTF-8 if null) unless it
+     * contains only ASCII characters.
+     *
+     * Counter in @a hits is incremented for filter which decided the result.
+     */
+    bool accepts(const char *data, int size, bool ascii, QTextCodec *codec, qint64 *hits) const;
+
+private:
+    struct Filter {
+        QString pattern;
+        bool exclude;
+        /// Bytes which must be in line to match (empty if unknown).
+        QByteArray literal;
+        /// Literal is whole pattern so no other matching is needed.
+        bool literalOnly;
+        QRegExp re;
+    };
+
+    bool addFilter(const QString &pattern, bool exclude, QString *errorString);
+
+    /**
+     * Return true if filter matches the line (@a text is decoded lazily).
+     */
+    bool matches(const Filter &filter, const char *data, int size, bool ascii,
+                 QTextCodec *codec, QString *text, bool *decoded) const;
+
+    QVector<Filter> filters_;
+    bool hasIncludes_;
+};
+
+} // namespace traypost
@@ -0,0 +1,497 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "line_parser.h"
+
+#include <cstring>
+
+namespace traypost {
+
+namespace {
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char *skipSpaces(const char *p, const char *end)
+{
+    while (p != end && isSpace(*p))
+        ++p;
+    return p;
+}
+
+bool equals(const char *data, int size, const char *key)
+{
+    return static_cast<int>(strlen(key)) == size && memcmp(data, key, size) == 0;
+}
+
+/**
+ * Return field for key or nullptr if the key is not recognized.
+ */
+LineField *fieldForKey(const char *key, int size, LineFields *fields)
+{
+    switch (size > 0 ? key[0] : '\0') {
+    case 'm':
+        if ( equals(key, size, "msg") || equals(key, size, "message") )
+            return &fields->message;
+        break;
+    case 'l':
+        if ( equals(key, size, "level") || equals(key, size, "lvl") )
+            return &fields->level;
+        if ( equals(key, size, "logger") )
+            return &fields->source;
+        break;
+    case 's':
+        if ( equals(key, size, "severity") )
+            return &fields->level;
+        if ( equals(key, size, "source") )
+            return &fields->source;
+        break;
+    case 't':
+        if ( equals(key, size, "time") || equals(key, size, "ts") || equals(key, size, "timestamp") )
+            return &fields->time;
+        break;
+    case '@':
+        if ( equals(key, size, "@timestamp") )
+            return &fields->time;
+        break;
+    case 'a':
+        if ( equals(key, size, "app") )
+            return &fields->source;
+        break;
+    }
+
+    return nullptr;
+}
+
+/**
+ * Scan quoted string starting after opening quote.
+ * @return position after closing quote or nullptr if string is not terminated
+ */
+const char *scanString(const char *p, const char *end, LineField *field)
+{
+    field->data = p;
+    field->escaped = false;
+
+    for ( ; p != end; ++p ) {
+        if (*p == '\\') {
+            field->escaped = true;
+            if (++p == end)
+                return nullptr;
+        } else if (*p == '"') {
+            field->size = static_cast<int>(p - field->data);
+            return p + 1;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * Skip nested JSON object or array.
+ */
+const char *skipNested(const char *p, const char *end)
+{
+    int depth = 0;
+    LineField ignored;
+    while (p != end) {
+        const char c = *p++;
+        if (c == '"') {
+            p = scanString(p, end, &ignored);
+            if (p == nullptr)
+                return nullptr;
+        } else if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0)
+                return p;
+        }
+    }
+
+    return nullptr;
+}
+
+bool parseJson(const char *p, const char *end, LineFields *fields)
+{
+    p = skipSpaces(p, end);
+    if (p == end || *p != '{')
+        return false;
+    p = skipSpaces(p + 1, end);
+    if (p != end && *p == '}')
+        return true;
+
+    while (p != end) {
+        LineField key;
+        if (*p != '"')
+            return false;
+        p = scanString(p + 1, end, &key);
+        if (p == nullptr)
+            return false;
+
+        p = skipSpaces(p, end);
+        if (p == end || *p != ':')
+            return false;
+        p = skipSpaces(p + 1, end);
+        if (p == end)
+            return false;
+
+        LineField value;
+        if (*p == '"') {
+            p = scanString(p + 1, end, &value);
+        } else if (*p == '{' || *p == '[') {
+            p = skipNested(p, end);
+        } else {
+            // Number, boolean or null (only numbers are used as field values).
+            const char *begin = p;
+            while ( p != end && *p != ',' && *p != '}' && !isSpace(*p) )
+                ++p;
+            if ( *begin == '-' || (*begin >= '0' && *begin <= '9') ) {
+                value.data = begin;
+                value.size = static_cast<int>(p - begin);
+            }
+        }
+
+        if (p == nullptr)
+            return false;
+
+        LineField *field = fieldForKey(key.data, key.size, fields);
+        if (field != nullptr && !value.isNull())
+            *field = value;
+
+        p = skipSpaces(p, end);
+        if (p == end)
+            return false;
+        if (*p == '}')
+            return true;
+        if (*p != ',')
+            return false;
+        p = skipSpaces(p + 1, end);
+    }
+
+    return false;
+}
+
+bool parseLogfmt(const char *p, const char *end, LineFields *fields)
+{
+    bool found = false;
+
+    while (true) {
+        p = skipSpaces(p, end);
+        if (p == end)
+            return found;
+
+        const char *key = p;
+        while ( p != end && *p != '=' && !isSpace(*p) )
+            ++p;
+        const int keySize = static_cast<int>(p - key);
+
+        // Key without value.
+        if (p == end || *p != '=')
+            continue;
+        ++p;
+
+        LineField value;
+        if (p != end && *p == '"') {
+            p = scanString(p + 1, end, &value);
+            if (p == nullptr)
+                return false;
+        } else {
+            value.data = p;
+            while ( p != end && !isSpace(*p) )
+                ++p;
+            value.size = static_cast<int>(p - value.data);
+        }
+
+        LineField *field = fieldForKey(key, keySize, fields);
+        if (field != nullptr) {
+            *field = value;
+            found = true;
+        }
+    }
+}
+
+int parseDigits(const char *&p, const char *end, int count)
+{
+    int result = 0;
+    for (int i = 0; i < count; ++i, ++p) {
+        if (p == end || *p < '0' || *p > '9')
+            return -1;
+        result = result * 10 + (*p - '0');
+    }
+    return result;
+}
+
+/**
+ * Return number of days since epoch for date (proleptic Gregorian calendar).
+ */
+qint64 daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2 ? 1 : 0;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = static_cast<int>(year - era * 400);
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+bool parseIsoTime(const char *p, const char *end, qint64 *ms)
+{
+    const int year = parseDigits(p, end, 4);
+    if (year < 0 || p == end || *p++ != '-')
+        return false;
+    const int month = parseDigits(p, end, 2);
+    if (month < 1 || month > 12 || p == end || *p++ != '-')
+        return false;
+    const int day = parseDigits(p, end, 2);
+    if (day < 1 || day > 31 || p == end || (*p != 'T' && *p != ' '))
+        return false;
+    ++p;
+    const int hour = parseDigits(p, end, 2);
+    if (hour < 0 || p == end || *p++ != ':')
+        return false;
+    const int minute = parseDigits(p, end, 2);
+    if (minute < 0 || p == end || *p++ != ':')
+        return false;
+    const int second = parseDigits(p, end, 2);
+    if (second < 0)
+        return false;
+
+    int millisecond = 0;
+    if (p != end && (*p == '.' || *p == ',')) {
+        ++p;
+        int scale = 100;
+        for ( ; p != end && *p >= '0' && *p <= '9'; ++p, scale /= 10 )
+            millisecond += (*p - '0') * scale;
+    }
+
+    int offsetMinutes = 0;
+    if (p != end && (*p == '+' || *p == '-')) {
+        const int sign = *p++ == '-' ? -1 : 1;
+        const int offsetHour = parseDigits(p, end, 2);
+        if (p != end && *p == ':')
+            ++p;
+        const int offsetMinute = p == end ? 0 : parseDigits(p, end, 2);
+        if (offsetHour < 0 || offsetMinute < 0)
+            return false;
+        offsetMinutes = sign * (offsetHour * 60 + offsetMinute);
+    } else if (p != end && *p == 'Z') {
+        ++p;
+    }
+
+    if (p != end)
+        return false;
+
+    const qint64 seconds = daysFromCivil(year, month, day) * 86400
+            + hour * 3600 + minute * 60 + second - offsetMinutes * 60;
+    *ms = seconds * 1000 + millisecond;
+    return true;
+}
+
+bool parseEpochTime(const char *p, const char *end, qint64 *ms)
+{
+    if (p == end)
+        return false;
+
+    qint64 integer = 0;
+    for ( ; p != end && *p >= '0' && *p <= '9'; ++p )
+        integer = integer * 10 + (*p - '0');
+
+    int fraction = 0;
+    if (p != end && *p == '.') {
+        ++p;
+        int scale = 100;
+        for ( ; p != end && *p >= '0' && *p <= '9'; ++p, scale /= 10 )
+            fraction += (*p - '0') * scale;
+    }
+
+    if (p != end)
+        return false;
+
+    // Seconds until year 5138.
+    *ms = integer >= Q_INT64_C(100000000000) ? integer : integer * 1000 + fraction;
+    return true;
+}
+
+void appendUtf8(uint code, QByteArray *out)
+{
+    if (code < 0x80) {
+        out->append( static_cast<char>(code) );
+    } else if (code < 0x800) {
+        out->append( static_cast<char>(0xc0 | (code >> 6)) );
+        out->append( static_cast<char>(0x80 | (code & 0x3f)) );
+    } else if (code < 0x10000) {
+        out->append( static_cast<char>(0xe0 | (code >> 12)) );
+        out->append( static_cast<char>(0x80 | ((code >> 6) & 0x3f)) );
+        out->append( static_cast<char>(0x80 | (code & 0x3f)) );
+    } else {
+        out->append( static_cast<char>(0xf0 | (code >> 18)) );
+        out->append( static_cast<char>(0x80 | ((code >> 12) & 0x3f)) );
+        out->append( static_cast<char>(0x80 | ((code >> 6) & 0x3f)) );
+        out->append( static_cast<char>(0x80 | (code & 0x3f)) );
+    }
+}
+
+int parseHex4(const char *p, const char *end)
+{
+    if (end - p < 4)
+        return -1;
+
+    int result = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = p[i];
+        result <<= 4;
+        if (c >= '0' && c <= '9')
+            result |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            result |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            result |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return result;
+}
+
+} // namespace
+
+bool parseLineFields(const char *data, int size, InputFormat format, LineFields *fields)
+{
+    *fields = LineFields();
+
+    switch (format) {
+    case JsonInput:
+        return parseJson(data, data + size, fields);
+    case LogfmtInput:
+        return parseLogfmt(data, data + size, fields);
+    case PlainInput:
+        break;
+    }
+
+    return false;
+}
+
+QString fieldText(const LineField &field)
+{
+    if (!field.escaped)
+        return QString::fromUtf8(field.data, field.size);
+
+    QByteArray result;
+    result.reserve(field.size);
+
+    const char *end = field.data + field.size;
+    for (const char *p = field.data; p != end; ++p) {
+        if (*p != '\\' || p + 1 == end) {
+            result.append(*p);
+            continue;
+        }
+
+        switch (*++p) {
+        case 'n': result.append('\n'); break;
+        case 't': result.append('\t'); break;
+        case 'r': result.append('\r'); break;
+        case 'b': result.append('\b'); break;
+        case 'f': result.append('\f'); break;
+        case 'u': {
+            int code = parseHex4(p + 1, end);
+            if (code == -1) {
+                result.append(*p);
+                break;
+            }
+            p += 4;
+
+            // Surrogate pair.
+            if (code >= 0xd800 && code < 0xdc00 && end - p > 6 && p[1] == '\\' && p[2] == 'u') {
+                const int low = parseHex4(p + 3, end);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    p += 6;
+                }
+            }
+            appendUtf8(code, &result);
+            break;
+        }
+        default:
+            result.append(*p);
+        }
+    }
+
+    return QString::fromUtf8(result);
+}
+
+Record::Level parseLevel(const LineField &field)
+{
+    if (field.size == 0)
+        return Record::NoLevel;
+
+    const char c = field.data[0];
+    if (c >= '0' && c <= '9') {
+        int n = 0;
+        for (int i = 0; i < field.size && field.data[i] >= '0' && field.data[i] <= '9'; ++i)
+            n = n * 10 + (field.data[i] - '0');
+
+        // Syslog severity.
+        if (n < 10) {
+            return n <= 3 ? Record::ErrorLevel
+                 : n == 4 ? Record::WarningLevel
+                 : n <= 6 ? Record::InfoLevel
+                 : Record::DebugLevel;
+        }
+
+        // Bunyan/pino levels.
+        return n >= 50 ? Record::ErrorLevel
+             : n >= 40 ? Record::WarningLevel
+             : n >= 30 ? Record::InfoLevel
+             : Record::DebugLevel;
+    }
+
+    switch (c | 0x20) {
+    case 't':
+    case 'd':
+        return Record::DebugLevel;
+    case 'i':
+    case 'n':
+        return Record::InfoLevel;
+    case 'w':
+        return Record::WarningLevel;
+    case 'e':
+    case 'f':
+    case 'c':
+    case 'a':
+    case 'p':
+        return Record::ErrorLevel;
+    }
+
+    return Record::NoLevel;
+}
+
+bool parseTime(const LineField &field, qint64 *ms)
+{
+    const char *begin = field.data;
+    const char *end = field.data + field.size;
+    if (begin == end)
+        return false;
+
+    if ( field.size >= 10 && begin[4] == '-' )
+        return parseIsoTime(begin, end, ms);
+
+    return parseEpochTime(begin, end, ms);
+}
+
+} // namespace traypost
@@ -0,0 +1,86 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "record.h"
+
+namespace traypost {
+
+/**
+ * Field value in line (points to line data).
+ */
+struct LineField {
+    LineField() : data(nullptr), size(0), escaped(false) {}
+
+    bool isNull() const { return data == nullptr; }
+
+    const char *data;
+    int size;
+    /// Value contains backslash escape sequences.
+    bool escaped;
+};
+
+/**
+ * Fields found in structured line.
+ */
+struct LineFields {
+    LineField message;
+    LineField level;
+    LineField time;
+    LineField source;
+};
+
+enum InputFormat {
+    PlainInput,
+    /// JSON object per line (e.g. {"level": "warn", "msg": "..."}).
+    JsonInput,
+    /// Key-value pairs (e.g. level=warn msg="...").
+    LogfmtInput
+};
+
+/**
+ * Find message, level, time and source fields in line in single pass without
+ * copying data.
+ *
+ * Recognized keys are "msg"/"message", "level"/"lvl"/"severity",
+ * "time"/"ts"/"timestamp"/"@timestamp" and "source"/"logger"/"app".
+ *
+ * @return false if line has different format or no recognized fields
+ */
+bool parseLineFields(const char *data, int size, InputFormat format, LineFields *fields);
+
+/**
+ * Return field value as UTF-8 decoded text with escape sequences resolved.
+ */
+QString fieldText(const LineField &field);
+
+/**
+ * Return level for level name (e.g. "warn", "ERROR") or number (syslog
+ * severity or 10-60 as used by Bunyan).
+ */
+Record::Level parseLevel(const LineField &field);
+
+/**
+ * Parse time in ISO 8601 format (UTC if time zone is missing) or as number of
+ * seconds (or milliseconds if it's too big) since epoch.
+ */
+bool parseTime(const LineField &field, qint64 *ms);
+
+} // namespace traypost
@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "line_splitter.h"
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#   if (defined(__GNUC__) || defined(__clang__)) && !defined(__AVX2__)
+#       define TRAYPOST_AVX2_DISPATCH
+#       include <immintrin.h>
+#   elif defined(__AVX2__)
+#       include <immintrin.h>
+#   endif
+#endif
+
+namespace traypost {
+
+namespace {
+
+typedef const char *(*FindLineEndFunction)(const char *, const char *, bool *, char);
+
+const char *findLineEndScalar(const char *begin, const char *end, bool *ascii, char separator)
+{
+    unsigned char high = 0;
+    const char *p = begin;
+    for ( ; p != end && *p != separator; ++p )
+        high |= static_cast<unsigned char>(*p);
+
+    if (high & 0x80)
+        *ascii = false;
+
+    return p;
+}
+
+#if defined(__SSE2__) && !defined(__AVX2__)
+const char *findLineEndSse2(const char *begin, const char *end, bool *ascii, char separator)
+{
+    const __m128i separators = _mm_set1_epi8(separator);
+    int high = 0;
+
+    const char *p = begin;
+    for ( ; end - p >= 16; p += 16 ) {
+        const __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+        const int found = _mm_movemask_epi8( _mm_cmpeq_epi8(chunk, separators) );
+        const int chunkHigh = _mm_movemask_epi8(chunk);
+        if (found != 0) {
+            const int pos = __builtin_ctz(found);
+            high |= chunkHigh & ((1 << pos) - 1);
+            if (high != 0)
+                *ascii = false;
+            return p + pos;
+        }
+        high |= chunkHigh;
+    }
+
+    if (high != 0)
+        *ascii = false;
+
+    return findLineEndScalar(p, end, ascii, separator);
+}
+#endif
+
+#if defined(__AVX2__) || defined(TRAYPOST_AVX2_DISPATCH)
+#   if defined(TRAYPOST_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+#   endif
+const char *findLineEndAvx2(const char *begin, const char *end, bool *ascii, char separator)
+{
+    const __m256i separators = _mm256_set1_epi8(separator);
+    unsigned int high = 0;
+
+    const char *p = begin;
+    for ( ; end - p >= 32; p += 32 ) {
+        const __m256i chunk = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) );
+        const unsigned int found =
+                static_cast<unsigned int>( _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, separators)) );
+        const unsigned int chunkHigh = static_cast<unsigned int>( _mm256_movemask_epi8(chunk) );
+        if (found != 0) {
+            const int pos = __builtin_ctz(found);
+            high |= chunkHigh & ((1u << pos) - 1);
+            if (high != 0)
+                *ascii = false;
+            return p + pos;
+        }
+        high |= chunkHigh;
+    }
+
+    if (high != 0)
+        *ascii = false;
+
+    return findLineEndScalar(p, end, ascii, separator);
+}
+#endif
+
+FindLineEndFunction bestFindLineEnd()
+{
+#if defined(__AVX2__)
+    return &findLineEndAvx2;
+#elif defined(TRAYPOST_AVX2_DISPATCH)
+    if ( __builtin_cpu_supports("avx2") )
+        return &findLineEndAvx2;
+    return &findLineEndSse2;
+#elif defined(__SSE2__)
+    return &findLineEndSse2;
+#else
+    return &findLineEndScalar;
+#endif
+}
+
+} // namespace
+
+const char *findLineEnd(const char *begin, const char *end, bool *ascii, char separator)
+{
+    static const FindLineEndFunction f = bestFindLineEnd();
+    return f(begin, end, ascii, separator);
+}
+
+} // namespace traypost
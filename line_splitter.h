@@ -0,0 +1,35 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace traypost {
+
+/**
+ * Return pointer to first @a separator (new line by default) in range or
+ * @a end if there is none.
+ *
+ * Sets @a ascii to false if any character before returned position is not
+ * 7-bit ASCII (otherwise @a ascii is left unchanged).
+ *
+ * Uses SSE2 or AVX2 (detected at run time) on x86.
+ */
+const char *findLineEnd(const char *begin, const char *end, bool *ascii, char separator = '\n');
+
+} // namespace traypost
@@ -20,47 +20,42 @@
 #include "log_dialog.h"
 #include "ui_log_dialog.h"
 
-#include <QScrollBar>
+#include "log_item_delegate.h"
+#include "log_model.h"
+#include "log_search.h"
 
-#if QT_VERSION < 0x050000
-#   include <QTextDocument> // Qt::escape()
-#endif
+#include <QPushButton>
+#include <QScrollBar>
 
 namespace traypost {
 
-namespace {
-
-QString escapeHtml(const QString &str)
-{
-#if QT_VERSION < 0x050000
-    return Qt::escape(str);
-#else
-    return str.toHtmlEscaped();
-#endif
-}
-
-} // namespace
-
-QString Record::toString(const QString &format, const QString &timeFormat) const
-{
-    return format.arg( escapeHtml(text) ).arg( time.toString(timeFormat) );
-}
-
-LogDialog::LogDialog(const QList<Record> &records, const QString &format,
-                     const QString &timeFormat, QWidget *parent)
+LogDialog::LogDialog(const RecordStore &records, const TrigramIndex &index,
+                     const MessageFormat &format, QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::LogDialog)
-    , timeFormat_(timeFormat)
-    , format_(format)
+    , model_( new LogModel(records, format, this) )
+    , search_( new LogSearch(records, index, this) )
+    , searchTimer_()
 {
     ui->setupUi(this);
     ui->listLog->setUniformItemSizes(true);
-
-    for (auto &record : records) {
-        createRecord(record);
-    }
-
-    ui->listLog->setCurrentRow(0);
+    ui->listLog->setItemDelegate( new LogItemDelegate(ui->listLog) );
+    ui->listLog->setModel(model_);
+
+    ui->listLog->setCurrentIndex( model_->index(0) );
+    ui->labelSearchStatus->hide();
+    ui->comboBoxSource->hide();
+    ui->comboBoxLevel->hide();
+
+    QPushButton *buttonExport =
+            ui->buttonBox->addButton( tr("&Export..."), QDialogButtonBox::ActionRole );
+    connect( buttonExport, SIGNAL(clicked()), this, SIGNAL(exportRequested()) );
+
+    connect( search_, SIGNAL(matchesFound(QVector<qint64>)),
+             this, SLOT(onMatchesFound(QVector<qint64>)) );
+    connect( search_, SIGNAL(rankedMatchesFound(QVector<qint64>)),
+             this, SLOT(onRankedMatchesFound(QVector<qint64>)) );
+    connect( search_, SIGNAL(finished()), this, SLOT(onSearchFinished()) );
 }
 
 LogDialog::~LogDialog()
@@ -68,30 +63,56 @@ LogDialog::~LogDialog()
     delete ui;
 }
 
-void LogDialog::addRecord(const Record &record)
+void LogDialog::updateRecords()
 {
     auto scrollBar = ui->listLog->verticalScrollBar();
     bool atBottom = scrollBar->value() == scrollBar->maximum();
 
-    auto item = createRecord(record);
+    const int rowCount = model_->rowCount();
+    model_->updateRecords();
 
-    if ( isFilteredOut(item, ui->lineEditSearch->text()) )
-        item->setHidden(true);
-    else if (atBottom && scrollBar->value() != 0)
-        ui->listLog->scrollToItem(item);
+    if ( atBottom && scrollBar->value() != 0 && model_->rowCount() != rowCount )
+        ui->listLog->scrollToBottom();
 }
 
-bool LogDialog::isFilteredOut(QListWidgetItem *item, const QString &text) const
+void LogDialog::updateLastRecord()
 {
-    auto widget = ui->listLog->itemWidget(item);
-    auto itemText = widget->property("text").toString();
-    return !itemText.contains(text, Qt::CaseInsensitive);
+    model_->updateLastRecord();
 }
 
-void LogDialog::on_listLog_itemActivated(QListWidgetItem *item)
+void LogDialog::setSources(const QStringList &names)
 {
-    int row = ui->listLog->row(item);
-    emit itemActivated(row);
+    // Keep selected source (new sources are only appended).
+    const int current = ui->comboBoxSource->currentIndex();
+    ui->comboBoxSource->blockSignals(true);
+    ui->comboBoxSource->clear();
+    ui->comboBoxSource->addItem( tr("All inputs") );
+    ui->comboBoxSource->addItems(names);
+    ui->comboBoxSource->setCurrentIndex( current < ui->comboBoxSource->count() ? current : 0 );
+    ui->comboBoxSource->blockSignals(false);
+    ui->comboBoxSource->setVisible( names.size() > 1 );
+}
+
+void LogDialog::setLevelFilterVisible(bool visible)
+{
+    ui->comboBoxLevel->setVisible(visible);
+}
+
+void LogDialog::setSearchMode(SearchQuery::Mode mode)
+{
+    ui->comboBoxSearchMode->setCurrentIndex(mode);
+}
+
+void LogDialog::stopSearch()
+{
+    search_->stop();
+}
+
+void LogDialog::on_listLog_activated(const QModelIndex &index)
+{
+    int row = model_->recordRow( index.row() );
+    if (row != -1)
+        emit itemActivated(row);
 }
 
 void LogDialog::on_buttonReset_clicked()
@@ -99,26 +120,102 @@ void LogDialog::on_buttonReset_clicked()
     ui->lineEditSearch->clear();
 }
 
-void LogDialog::on_lineEditSearch_textChanged(const QString &text)
+void LogDialog::on_lineEditSearch_textChanged(const QString &)
+{
+    search();
+}
+
+void LogDialog::on_lineEditSearch_returnPressed()
+{
+    const QModelIndex index = ui->listLog->currentIndex();
+    if ( index.isValid() )
+        on_listLog_activated(index);
+}
+
+void LogDialog::on_comboBoxSearchMode_currentIndexChanged(int)
+{
+    search();
+}
+
+void LogDialog::on_checkBoxCaseSensitive_toggled(bool)
+{
+    search();
+}
+
+void LogDialog::on_comboBoxSource_currentIndexChanged(int)
+{
+    search();
+}
+
+void LogDialog::on_comboBoxLevel_currentIndexChanged(int)
+{
+    search();
+}
+
+void LogDialog::onMatchesFound(const QVector<qint64> &ids)
+{
+    model_->addMatches(ids);
+}
+
+void LogDialog::onRankedMatchesFound(const QVector<qint64> &ids)
 {
-    auto list = ui->listLog;
-    for ( int row = 0; row < list->count(); ++row ) {
-        auto item = list->item(row);
-        item->setHidden( isFilteredOut(item, text) );
+    // Keep record selected by user (below the best match) while results are
+    // streamed in.
+    const QModelIndex current = ui->listLog->currentIndex();
+    const qint64 currentId = current.isValid() && current.row() > 0
+            ? model_->recordId( current.row() ) : -1;
+
+    model_->setRankedMatches(ids);
+
+    const int row = currentId == -1 ? -1 : model_->rowForId(currentId);
+    if (row != -1) {
+        ui->listLog->setCurrentIndex( model_->index(row) );
+    } else {
+        // Best match can be selected right away.
+        ui->listLog->setCurrentIndex( model_->index(0) );
+        ui->listLog->scrollToTop();
     }
 }
 
-QListWidgetItem *LogDialog::createRecord(const Record &record)
+void LogDialog::onSearchFinished()
 {
-    auto w = new QLabel( record.toString(format_, timeFormat_), ui->listLog );
-    w->setContentsMargins(4, 4, 4, 4);
+    const double ms = searchTimer_.nsecsElapsed() / 1e6;
+    ui->labelSearchStatus->setText(
+                tr("%n match(es) in %1 ms", "", model_->rowCount()).arg(ms, 0, 'f', 1) );
+}
+
+void LogDialog::search()
+{
+    SearchQuery query;
+    query.text = ui->lineEditSearch->text();
+    query.mode = static_cast<SearchQuery::Mode>( ui->comboBoxSearchMode->currentIndex() );
+    query.caseSensitivity = ui->checkBoxCaseSensitive->isChecked()
+            ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    query.source = ui->comboBoxSource->currentIndex() - 1;
+    query.minLevel = ui->comboBoxLevel->currentIndex();
+
+    RecordMatcher matcher(query);
+
+    searchTimer_.start();
+    search_->cancel();
+
+    if ( !matcher.isValid() ) {
+        model_->setFilter( RecordMatcher() );
+        ui->labelSearchStatus->setText( tr("Invalid regular expression") );
+        ui->labelSearchStatus->show();
+        return;
+    }
+
+    model_->setFilter(matcher);
 
-    auto item = new QListWidgetItem(ui->listLog);
-    item->setSizeHint(w->sizeHint());
-    ui->listLog->addItem(item);
-    ui->listLog->setItemWidget(item, w);
+    if ( matcher.isEmpty() ) {
+        ui->labelSearchStatus->hide();
+        return;
+    }
 
-    return item;
+    ui->labelSearchStatus->setText( tr("Searching...") );
+    ui->labelSearchStatus->show();
+    search_->start( matcher, model_->firstId(), model_->endId() );
 }
 
 } // namespace traypost
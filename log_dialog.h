@@ -17,10 +17,16 @@
     along with CopyQ.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#pragma once
+
+#include "log_search.h"
+#include "record_store.h"
+
 #include <QDialog>
-#include <QDateTime>
+#include <QElapsedTimer>
+#include <QStringList>
 
-class QListWidgetItem;
+class QModelIndex;
 
 namespace Ui {
 class LogDialog;
@@ -28,42 +34,79 @@ class LogDialog;
 
 namespace traypost {
 
-struct Record {
-    Record() : text(), time() {}
-    Record(const QString &text) : text(text), time(QDateTime::currentDateTime()) {}
-    QString toString(const QString &format, const QString &timeFormat) const;
-
-    QString text;
-    QDateTime time;
-};
+class LogModel;
+class LogSearch;
+class MessageFormat;
+class TrigramIndex;
 
 class LogDialog : public QDialog
 {
     Q_OBJECT
 public:
-    explicit LogDialog(const QList<Record> &records, const QString &format,
-                       const QString &timeFormat, QWidget *parent = nullptr);
+    LogDialog(const RecordStore &records, const TrigramIndex &index, const MessageFormat &format,
+              QWidget *parent = nullptr);
 
     ~LogDialog();
 
-    void addRecord(const Record &record);
+    /**
+     * Show records appended since last call.
+     */
+    void updateRecords();
+
+    /**
+     * Refresh last record (e.g. after it was repeated).
+     */
+    void updateLastRecord();
 
-    bool isFilteredOut(QListWidgetItem *item, const QString &text) const;
+    /**
+     * Set input names for source filter (hidden for single input).
+     */
+    void setSources(const QStringList &names);
+
+    /**
+     * Show level filter (for structured input).
+     */
+    void setLevelFilterVisible(bool visible);
+
+    /**
+     * Select search mode (e.g. fuzzy search for selecting items).
+     */
+    void setSearchMode(SearchQuery::Mode mode);
+
+    /**
+     * Cancel running search and wait for it (e.g. before exit).
+     */
+    void stopSearch();
 
 signals:
     void itemActivated(int row);
 
+    /**
+     * User requested to export log.
+     */
+    void exportRequested();
+
 private slots:
-    void on_listLog_itemActivated(QListWidgetItem *item);
+    void on_listLog_activated(const QModelIndex &index);
     void on_buttonReset_clicked();
     void on_lineEditSearch_textChanged(const QString &text);
+    void on_lineEditSearch_returnPressed();
+    void on_comboBoxSearchMode_currentIndexChanged(int index);
+    void on_checkBoxCaseSensitive_toggled(bool checked);
+    void on_comboBoxSource_currentIndexChanged(int index);
+    void on_comboBoxLevel_currentIndexChanged(int index);
+
+    void onMatchesFound(const QVector<qint64> &ids);
+    void onRankedMatchesFound(const QVector<qint64> &ids);
+    void onSearchFinished();
 
 private:
-    QListWidgetItem *createRecord(const Record &record);
+    void search();
 
     Ui::LogDialog *ui;
-    QString timeFormat_;
-    QString format_;
+    LogModel *model_;
+    LogSearch *search_;
+    QElapsedTimer searchTimer_;
 };
 
 } // namespace traypost
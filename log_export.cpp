@@ -0,0 +1,329 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log_export.h"
+
+#include "record_store.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QEvent>
+#include <QFile>
+#include <QRunnable>
+
+namespace traypost {
+
+namespace {
+
+/// Size of data written at once.
+constexpr int writeBufferSize = 1024 * 1024;
+
+/// Number of records between progress reports.
+constexpr int progressInterval = 16 * 1024;
+
+const QEvent::Type progressEventType =
+        static_cast<QEvent::Type>( QEvent::registerEventType() );
+
+const QEvent::Type finishedEventType =
+        static_cast<QEvent::Type>( QEvent::registerEventType() );
+
+class ProgressEvent : public QEvent
+{
+public:
+    ProgressEvent(int generation, qint64 written, qint64 total)
+        : QEvent(progressEventType)
+        , generation(generation)
+        , written(written)
+        , total(total)
+    {
+    }
+
+    int generation;
+    qint64 written;
+    qint64 total;
+};
+
+class FinishedEvent : public QEvent
+{
+public:
+    FinishedEvent(int generation, bool ok, const QString &errorString)
+        : QEvent(finishedEventType)
+        , generation(generation)
+        , ok(ok)
+        , errorString(errorString)
+    {
+    }
+
+    int generation;
+    bool ok;
+    QString errorString;
+};
+
+void appendJsonString(const QString &text, QByteArray *out)
+{
+    out->append('"');
+
+    // Append unescaped parts at once.
+    int start = 0;
+    for (int i = 0; i < text.size(); ++i) {
+        const ushort u = text[i].unicode();
+        if (u >= 0x20 && u != '"' && u != '\\')
+            continue;
+
+        out->append( text.mid(start, i - start).toUtf8() );
+        start = i + 1;
+
+        if (u == '"' || u == '\\')
+            out->append('\\').append( static_cast<char>(u) );
+        else if (u == '\n')
+            out->append("\\n");
+        else if (u == '\t')
+            out->append("\\t");
+        else
+            out->append( QString("\\u%1").arg(u, 4, 16, QChar('0')).toLatin1() );
+    }
+    out->append( text.mid(start).toUtf8() );
+
+    out->append('"');
+}
+
+void appendCsvField(const QString &text, QByteArray *out)
+{
+    QByteArray field = text.toUtf8();
+    if ( field.contains('"') || field.contains(',') || field.contains('\n') || field.contains('\r') ) {
+        field.replace("\"", "\"\"");
+        out->append('"').append(field).append('"');
+    } else {
+        out->append(field);
+    }
+}
+
+class ExportTask : public QRunnable
+{
+public:
+    ExportTask(QObject *receiver, int generation,
+               const std::shared_ptr< std::atomic<bool> > &cancelled,
+               const RecordStore &records, const QStringList &sources,
+               const QString &fileName, LogExport::Format format,
+               qint64 firstId, qint64 endId)
+        : receiver_(receiver)
+        , generation_(generation)
+        , cancelled_(cancelled)
+        , records_(records)
+        , sources_(sources)
+        , fileName_(fileName)
+        , format_(format)
+        , firstId_(firstId)
+        , endId_(endId)
+        , lastSecond_(-1)
+        , lastSecondText_()
+    {
+    }
+
+    void run()
+    {
+        QString errorString;
+        const bool ok = exportRecords(&errorString);
+        QCoreApplication::postEvent( receiver_, new FinishedEvent(generation_, ok, errorString) );
+    }
+
+private:
+    bool exportRecords(QString *errorString)
+    {
+        QFile file(fileName_);
+        if ( !file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered) ) {
+            *errorString = QObject::tr("Cannot open file \"%1\": %2")
+                    .arg(fileName_).arg( file.errorString() );
+            return false;
+        }
+
+        QByteArray buffer;
+        buffer.reserve(writeBufferSize + 64 * 1024);
+
+        if (format_ == LogExport::Csv)
+            buffer.append("text,time,source\n");
+
+        const qint64 total = endId_ - firstId_;
+        Record record;
+        for (qint64 id = firstId_; id < endId_; ++id) {
+            if ( records_.recordById(id, &record) )
+                appendRecord(record, &buffer);
+
+            if (buffer.size() >= writeBufferSize && !write(&file, &buffer, errorString))
+                return false;
+
+            const qint64 written = id - firstId_ + 1;
+            if (written % progressInterval == 0) {
+                if (*cancelled_) {
+                    file.remove();
+                    *errorString = QObject::tr("Export cancelled");
+                    return false;
+                }
+                QCoreApplication::postEvent(
+                            receiver_, new ProgressEvent(generation_, written, total) );
+            }
+        }
+
+        return write(&file, &buffer, errorString);
+    }
+
+    bool write(QFile *file, QByteArray *buffer, QString *errorString)
+    {
+        if ( file->write(*buffer) != buffer->size() ) {
+            *errorString = QObject::tr("Cannot write file \"%1\": %2")
+                    .arg(fileName_).arg( file->errorString() );
+            return false;
+        }
+
+        buffer->clear();
+        return true;
+    }
+
+    void appendRecord(const Record &record, QByteArray *out)
+    {
+        switch (format_) {
+        case LogExport::PlainText:
+            out->append( record.text.toUtf8() );
+            break;
+
+        case LogExport::JsonLines:
+            out->append("{\"text\": ");
+            appendJsonString(record.text, out);
+            out->append(", \"time\": \"").append( formatTime(record.eventTime) ).append("\"");
+            out->append(", \"source\": ");
+            appendJsonString(sources_.value(record.source), out);
+            out->append('}');
+            break;
+
+        case LogExport::Csv:
+            appendCsvField(record.text, out);
+            out->append(',').append( formatTime(record.eventTime) ).append(',');
+            appendCsvField(sources_.value(record.source), out);
+            break;
+        }
+
+        out->append('\n');
+    }
+
+    /**
+     * Return time in ISO 8601 format (UTC).
+     */
+    QByteArray formatTime(qint64 ms)
+    {
+        const qint64 second = ms / 1000;
+        if (second != lastSecond_) {
+            lastSecond_ = second;
+            lastSecondText_ = QDateTime::fromMSecsSinceEpoch(second * 1000).toUTC()
+                    .toString("yyyy-MM-ddThh:mm:ss").toLatin1();
+        }
+
+        return lastSecondText_ + QString(".%1Z").arg(ms % 1000, 3, 10, QChar('0')).toLatin1();
+    }
+
+    QObject *receiver_;
+    int generation_;
+    std::shared_ptr< std::atomic<bool> > cancelled_;
+    const RecordStore &records_;
+    QStringList sources_;
+    QString fileName_;
+    LogExport::Format format_;
+    qint64 firstId_;
+    qint64 endId_;
+
+    qint64 lastSecond_;
+    QByteArray lastSecondText_;
+};
+
+} // namespace
+
+LogExport::LogExport(const RecordStore &records, QObject *parent)
+    : QObject(parent)
+    , records_(records)
+    , sources_()
+    , pool_()
+    , cancelled_()
+    , generation_(0)
+    , running_(false)
+{
+    pool_.setMaxThreadCount(1);
+}
+
+LogExport::~LogExport()
+{
+    // Task must not post events to destroyed object.
+    cancel();
+    pool_.waitForDone();
+}
+
+LogExport::Format LogExport::formatForFileName(const QString &fileName)
+{
+    if ( fileName.endsWith(".jsonl", Qt::CaseInsensitive)
+         || fileName.endsWith(".json", Qt::CaseInsensitive) )
+    {
+        return JsonLines;
+    }
+
+    if ( fileName.endsWith(".csv", Qt::CaseInsensitive) )
+        return Csv;
+
+    return PlainText;
+}
+
+void LogExport::start(const QString &fileName, Format format)
+{
+    cancel();
+
+    cancelled_ = std::make_shared< std::atomic<bool> >(false);
+    running_ = true;
+
+    pool_.start( new ExportTask(this, generation_, cancelled_, records_, sources_,
+                                fileName, format, records_.firstId(), records_.nextId()) );
+}
+
+void LogExport::cancel()
+{
+    if (cancelled_ != nullptr)
+        *cancelled_ = true;
+
+    ++generation_;
+    running_ = false;
+}
+
+void LogExport::waitForFinished()
+{
+    pool_.waitForDone();
+    QCoreApplication::sendPostedEvents(this, finishedEventType);
+}
+
+void LogExport::customEvent(QEvent *event)
+{
+    if ( event->type() == progressEventType ) {
+        auto progressEvent = static_cast<ProgressEvent*>(event);
+        if (progressEvent->generation == generation_)
+            emit progress(progressEvent->written, progressEvent->total);
+    } else if ( event->type() == finishedEventType ) {
+        auto finishedEvent = static_cast<FinishedEvent*>(event);
+        if (finishedEvent->generation == generation_) {
+            running_ = false;
+            emit finished(finishedEvent->ok, finishedEvent->errorString);
+        }
+    }
+}
+
+} // namespace traypost
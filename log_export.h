@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+
+#include <atomic>
+#include <memory>
+
+namespace traypost {
+
+class RecordStore;
+
+/**
+ * Writes records to file in background thread.
+ *
+ * Records are read one by one from the store so exporting doesn't need copy of
+ * the log. Records evicted while exporting are skipped.
+ */
+class LogExport : public QObject
+{
+    Q_OBJECT
+public:
+    enum Format {
+        /// One record text per line.
+        PlainText,
+        /// JSON object with "text", "time" and "source" per line.
+        JsonLines,
+        /// Columns text, time and source.
+        Csv
+    };
+
+    explicit LogExport(const RecordStore &records, QObject *parent = nullptr);
+
+    ~LogExport();
+
+    /**
+     * Return format for file name suffix (".jsonl", ".csv", otherwise plain
+     * text).
+     */
+    static Format formatForFileName(const QString &fileName);
+
+    /**
+     * Set input names for source column.
+     */
+    void setSources(const QStringList &names) { sources_ = names; }
+
+    /**
+     * Start writing all current records to file (cancels running export).
+     */
+    void start(const QString &fileName, Format format);
+
+public slots:
+    void cancel();
+
+public:
+    /**
+     * Wait for running export to finish.
+     */
+    void waitForFinished();
+
+    bool isRunning() const { return running_; }
+
+signals:
+    /**
+     * Emitted periodically with number of written records.
+     */
+    void progress(qint64 written, qint64 total);
+
+    void finished(bool ok, const QString &errorString);
+
+protected:
+    void customEvent(QEvent *event);
+
+private:
+    const RecordStore &records_;
+    QStringList sources_;
+
+    QThreadPool pool_;
+    std::shared_ptr< std::atomic<bool> > cancelled_;
+    int generation_;
+    bool running_;
+};
+
+} // namespace traypost
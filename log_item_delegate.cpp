@@ -0,0 +1,89 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log_item_delegate.h"
+#include "log_model.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QApplication>
+#include <QPainter>
+
+namespace traypost {
+
+namespace {
+
+/// Same margin as record labels had.
+constexpr int itemMargin = 4;
+
+#if QT_VERSION < 0x050000
+typedef QStyleOptionViewItemV4 StyleOptionViewItem;
+#else
+typedef QStyleOptionViewItem StyleOptionViewItem;
+#endif
+
+} // namespace
+
+LogItemDelegate::LogItemDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+    , doc_()
+{
+    doc_.setDocumentMargin(itemMargin);
+}
+
+void LogItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                            const QModelIndex &index) const
+{
+    StyleOptionViewItem opt(option);
+    initStyleOption(&opt, index);
+    opt.text = QString();
+
+    // Draw background and selection.
+    QStyle *style = opt.widget != nullptr ? opt.widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, opt.widget);
+
+    setHtml(index, opt.font);
+
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette = opt.palette;
+    if (opt.state & QStyle::State_Selected) {
+        context.palette.setColor( QPalette::Text,
+                                  opt.palette.color(QPalette::Active, QPalette::HighlightedText) );
+    }
+    context.clip = QRectF( QPointF(0, 0), opt.rect.size() );
+
+    painter->save();
+    painter->translate( opt.rect.topLeft() );
+    painter->setClipRect(context.clip);
+    doc_.documentLayout()->draw(painter, context);
+    painter->restore();
+}
+
+QSize LogItemDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    setHtml(index, option.font);
+    return doc_.size().toSize();
+}
+
+void LogItemDelegate::setHtml(const QModelIndex &index, const QFont &font) const
+{
+    doc_.setDefaultFont(font);
+    doc_.setHtml( index.data(LogModel::HtmlRole).toString() );
+}
+
+} // namespace traypost
@@ -0,0 +1,47 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QStyledItemDelegate>
+#include <QTextDocument>
+
+namespace traypost {
+
+/**
+ * Paints formatted records (LogModel::HtmlRole).
+ */
+class LogItemDelegate : public QStyledItemDelegate
+{
+public:
+    explicit LogItemDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const;
+
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+private:
+    void setHtml(const QModelIndex &index, const QFont &font) const;
+
+    /// Reused for painting each row.
+    mutable QTextDocument doc_;
+};
+
+} // namespace traypost
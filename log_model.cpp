@@ -0,0 +1,238 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log_model.h"
+
+#include <algorithm>
+
+namespace traypost {
+
+LogModel::LogModel(const RecordStore &records, const MessageFormat &format, QObject *parent)
+    : QAbstractListModel(parent)
+    , records_(records)
+    , format_(format)
+    , recordCount_( records.size() )
+    , firstId_( records.firstId() )
+    , matcher_()
+    , ids_()
+    , rankedEndId_(0)
+{
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    if ( parent.isValid() )
+        return 0;
+    return isFiltered() ? ids_.size() : recordCount_;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if ( !index.isValid() )
+        return QVariant();
+
+    const int row = recordRow( index.row() );
+    if ( row < 0 || row >= records_.size() )
+        return QVariant();
+
+    const Record &record = records_[row];
+
+    if (role == Qt::DisplayRole)
+        return record.text;
+    if (role == HtmlRole)
+        return format_.format( record, records_.firstId() + row );
+
+    return QVariant();
+}
+
+int LogModel::recordRow(int row) const
+{
+    if ( !isFiltered() )
+        return row;
+
+    if ( row < 0 || row >= ids_.size() )
+        return -1;
+
+    return static_cast<int>( ids_[row] - records_.firstId() );
+}
+
+void LogModel::setFilter(const RecordMatcher &matcher)
+{
+    beginResetModel();
+
+    matcher_ = matcher;
+    ids_.clear();
+
+    recordCount_ = records_.size();
+    firstId_ = records_.firstId();
+    rankedEndId_ = endId();
+
+    endResetModel();
+}
+
+void LogModel::addMatches(const QVector<qint64> &ids)
+{
+    // Skip evicted records.
+    auto begin = std::lower_bound(ids.constBegin(), ids.constEnd(), firstId_);
+    if ( begin == ids.constEnd() || !isFiltered() || matcher_.isRanked() )
+        return;
+
+    const int count = static_cast<int>( ids.constEnd() - begin );
+
+    // IDs are from a range not yet in model so they are inserted together.
+    const int row = static_cast<int>(
+                std::lower_bound(ids_.constBegin(), ids_.constEnd(), *begin) - ids_.constBegin() );
+
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+    ids_.insert(row, count, 0);
+    std::copy( begin, ids.constEnd(), ids_.begin() + row );
+    endInsertRows();
+}
+
+void LogModel::setRankedMatches(const QVector<qint64> &ids)
+{
+    if ( !matcher_.isRanked() )
+        return;
+
+    beginResetModel();
+
+    QVector<qint64> newIds;
+    for (qint64 id : ids) {
+        if (id >= firstId_)
+            newIds.append(id);
+    }
+
+    // Keep records appended while searching.
+    for (qint64 id : ids_) {
+        if (id >= rankedEndId_)
+            newIds.append(id);
+    }
+
+    ids_ = newIds;
+
+    endResetModel();
+}
+
+qint64 LogModel::recordId(int row) const
+{
+    const int recordRow = this->recordRow(row);
+    return recordRow == -1 ? -1 : records_.firstId() + recordRow;
+}
+
+int LogModel::rowForId(qint64 id) const
+{
+    if ( !isFiltered() )
+        return id >= firstId_ && id < endId() ? static_cast<int>(id - firstId_) : -1;
+
+    return ids_.indexOf(id);
+}
+
+void LogModel::updateRecords()
+{
+    removeEvictedRecords();
+
+    const int count = records_.size();
+    if (count <= recordCount_)
+        return;
+
+    if ( !isFiltered() ) {
+        beginInsertRows(QModelIndex(), recordCount_, count - 1);
+        recordCount_ = count;
+        endInsertRows();
+        return;
+    }
+
+    QVector<qint64> newIds;
+    for (int i = recordCount_; i < count; ++i) {
+        if ( matcher_.matches(records_[i]) )
+            newIds.append(firstId_ + i);
+    }
+    recordCount_ = count;
+
+    if ( newIds.isEmpty() )
+        return;
+
+    beginInsertRows( QModelIndex(), ids_.size(), ids_.size() + newIds.size() - 1 );
+    ids_ += newIds;
+    endInsertRows();
+}
+
+void LogModel::updateLastRecord()
+{
+    if ( recordCount_ == 0 || records_.nextId() != endId() )
+        return;
+
+    const qint64 id = endId() - 1;
+    int row = -1;
+    if ( !isFiltered() )
+        row = recordCount_ - 1;
+    else if ( !ids_.isEmpty() && ids_.last() == id )
+        row = ids_.size() - 1;
+
+    if (row != -1) {
+        const QModelIndex index = this->index(row);
+        emit dataChanged(index, index);
+    }
+}
+
+void LogModel::removeEvictedRecords()
+{
+    const qint64 firstId = records_.firstId();
+    if (firstId == firstId_)
+        return;
+
+    const int removed = static_cast<int>( qMin<qint64>(firstId - firstId_, recordCount_) );
+
+    if ( !isFiltered() ) {
+        if (removed == 0) {
+            firstId_ = firstId;
+            return;
+        }
+
+        beginRemoveRows(QModelIndex(), 0, removed - 1);
+        recordCount_ -= removed;
+        firstId_ = firstId;
+        endRemoveRows();
+        return;
+    }
+
+    recordCount_ -= removed;
+    firstId_ = firstId;
+
+    if ( matcher_.isRanked() ) {
+        const auto isEvicted = [firstId](qint64 id) { return id < firstId; };
+        if ( std::any_of(ids_.constBegin(), ids_.constEnd(), isEvicted) ) {
+            beginResetModel();
+            ids_.erase( std::remove_if(ids_.begin(), ids_.end(), isEvicted), ids_.end() );
+            endResetModel();
+        }
+        return;
+    }
+
+    const int removedRows = static_cast<int>(
+                std::lower_bound(ids_.begin(), ids_.end(), firstId) - ids_.begin() );
+    if (removedRows == 0)
+        return;
+
+    beginRemoveRows(QModelIndex(), 0, removedRows - 1);
+    ids_.remove(0, removedRows);
+    endRemoveRows();
+}
+
+} // namespace traypost
@@ -0,0 +1,127 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "log_search.h"
+#include "message_format.h"
+#include "record_store.h"
+
+#include <QAbstractListModel>
+#include <QVector>
+
+namespace traypost {
+
+/**
+ * Model for records owned by tray.
+ *
+ * Rows can be filtered; recordRow() maps model row to index in records.
+ */
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum {
+        /// Record formatted as HTML.
+        HtmlRole = Qt::UserRole
+    };
+
+    LogModel(const RecordStore &records, const MessageFormat &format, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    /**
+     * Return index of record for model row.
+     */
+    int recordRow(int row) const;
+
+    /**
+     * Remove all rows if @a matcher is not empty and filter new records.
+     *
+     * Matching old records (with IDs lower than endId()) must be added with
+     * addMatches().
+     */
+    void setFilter(const RecordMatcher &matcher);
+
+    /**
+     * Show records with given IDs (sorted).
+     */
+    void addMatches(const QVector<qint64> &ids);
+
+    /**
+     * Show records with given IDs in given order (for ranked filter).
+     *
+     * Matching records added after the filter was set are kept after them.
+     */
+    void setRankedMatches(const QVector<qint64> &ids);
+
+    /**
+     * Return record ID for model row (-1 if row is invalid).
+     */
+    qint64 recordId(int row) const;
+
+    /**
+     * Return model row for record ID (-1 if record is not in model).
+     */
+    int rowForId(qint64 id) const;
+
+    /**
+     * Return ID of first record in model.
+     */
+    qint64 firstId() const { return firstId_; }
+
+    /**
+     * Return ID after last record in model.
+     */
+    qint64 endId() const { return firstId_ + recordCount_; }
+
+    /**
+     * Remove rows of evicted records and add rows for records appended since
+     * last call.
+     */
+    void updateRecords();
+
+    /**
+     * Update row of last record if it's in model (e.g. after it was repeated).
+     */
+    void updateLastRecord();
+
+private:
+    bool isFiltered() const { return !matcher_.isEmpty(); }
+
+    void removeEvictedRecords();
+
+    const RecordStore &records_;
+    MessageFormat format_;
+
+    /// Number of records already in model.
+    int recordCount_;
+    /// ID of first record in model.
+    qint64 firstId_;
+
+    RecordMatcher matcher_;
+    /// IDs of visible records if filter is set (sorted unless filter is ranked).
+    QVector<qint64> ids_;
+    /// End of records searched for ranked filter (newer are matched in updateRecords()).
+    qint64 rankedEndId_;
+};
+
+} // namespace traypost
@@ -0,0 +1,491 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log_search.h"
+
+#include "record_store.h"
+#include "trigram_index.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QPair>
+#include <QRunnable>
+
+#include <algorithm>
+
+namespace traypost {
+
+namespace {
+
+/// Number of records searched in one task.
+constexpr int chunkSize = 16 * 1024;
+
+/// How often tasks check for cancellation.
+constexpr int cancelCheckInterval = 256;
+
+/// Number of best ranked matches reported before search finishes.
+constexpr int rankedPreviewSize = 1000;
+
+/// Fuzzy score for each matched character and bonuses.
+constexpr int fuzzyMatchScore = 16;
+constexpr int fuzzyConsecutiveBonus = 8;
+constexpr int fuzzyWordStartBonus = 12;
+constexpr int fuzzyMaxStartPenalty = 15;
+
+const QEvent::Type chunkFinishedEventType =
+        static_cast<QEvent::Type>( QEvent::registerEventType() );
+
+class ChunkFinishedEvent : public QEvent
+{
+public:
+    ChunkFinishedEvent(int generation, const QVector<qint64> &ids, const QVector<int> &scores)
+        : QEvent(chunkFinishedEventType)
+        , generation(generation)
+        , ids(ids)
+        , scores(scores)
+    {
+    }
+
+    int generation;
+    QVector<qint64> ids;
+    /// Scores of ranked matches (ids are sorted by score).
+    QVector<int> scores;
+};
+
+bool isWordStart(const QString &text, int i)
+{
+    if (i == 0)
+        return true;
+
+    const QChar previous = text[i - 1];
+    const QChar c = text[i];
+    return !previous.isLetterOrNumber() || (previous.isLower() && c.isUpper());
+}
+
+QChar foldCase(QChar c, Qt::CaseSensitivity cs)
+{
+    return cs == Qt::CaseInsensitive ? c.toCaseFolded() : c;
+}
+
+/**
+ * Return true if all characters of @a pattern are in @a text in same order.
+ */
+bool isSubsequence(const QString &pattern, const QString &text)
+{
+    int i = 0;
+    for (int j = 0; i < pattern.size() && j < text.size(); ++j) {
+        if (pattern[i] == text[j])
+            ++i;
+    }
+    return i == pattern.size();
+}
+
+/**
+ * Searches range of records or list of candidate records.
+ */
+class SearchTask : public QRunnable
+{
+public:
+    SearchTask(QObject *receiver, int generation,
+               const std::shared_ptr< std::atomic<bool> > &cancelled,
+               const RecordStore &records, const RecordMatcher &matcher,
+               qint64 firstId, qint64 endId, const QVector<qint64> &candidates)
+        : receiver_(receiver)
+        , generation_(generation)
+        , cancelled_(cancelled)
+        , records_(records)
+        , matcher_(matcher)
+        , firstId_(firstId)
+        , endId_(endId)
+        , candidates_(candidates)
+        , checked_(0)
+        , matches_()
+    {
+    }
+
+    void run()
+    {
+        if ( candidates_.isEmpty() ) {
+            for (qint64 id = firstId_; id < endId_; ++id) {
+                if ( !check(id) )
+                    return;
+            }
+        } else {
+            for (qint64 id : candidates_) {
+                if ( !check(id) )
+                    return;
+            }
+        }
+
+        QVector<qint64> ids;
+        QVector<int> scores;
+
+        if ( matcher_.isRanked() ) {
+            std::stable_sort( matches_.begin(), matches_.end(),
+                              [](const QPair<int, qint64> &a, const QPair<int, qint64> &b) {
+                return a.first > b.first;
+            });
+            ids.reserve( matches_.size() );
+            scores.reserve( matches_.size() );
+            for (const auto &match : matches_) {
+                scores.append(match.first);
+                ids.append(match.second);
+            }
+        } else {
+            ids.reserve( matches_.size() );
+            for (const auto &match : matches_)
+                ids.append(match.second);
+        }
+
+        QCoreApplication::postEvent( receiver_, new ChunkFinishedEvent(generation_, ids, scores) );
+    }
+
+private:
+    /**
+     * Add ID and score if record matches.
+     * @return false if search was cancelled
+     */
+    bool check(qint64 id)
+    {
+        if ( ++checked_ % cancelCheckInterval == 0 && *cancelled_ )
+            return false;
+
+        Record record;
+        if ( !records_.recordById(id, &record) )
+            return true;
+
+        const int score = matcher_.score(record);
+        if (score >= 0)
+            matches_.append( qMakePair(score, id) );
+
+        return true;
+    }
+
+    QObject *receiver_;
+    int generation_;
+    std::shared_ptr< std::atomic<bool> > cancelled_;
+    const RecordStore &records_;
+    RecordMatcher matcher_;
+    qint64 firstId_;
+    qint64 endId_;
+    QVector<qint64> candidates_;
+    int checked_;
+    QVector< QPair<int, qint64> > matches_;
+};
+
+} // namespace
+
+RecordMatcher::RecordMatcher()
+    : query_()
+    , textMatcher_()
+    , re_()
+    , fuzzyText_()
+{
+}
+
+RecordMatcher::RecordMatcher(const SearchQuery &query)
+    : query_(query)
+    , textMatcher_(query.text, query.caseSensitivity)
+    , re_()
+    , fuzzyText_()
+{
+    if (query.mode == SearchQuery::WholeWords) {
+        re_ = QRegExp( "\\b" + QRegExp::escape(query.text) + "\\b",
+                       query.caseSensitivity, QRegExp::RegExp2 );
+    } else if (query.mode == SearchQuery::RegularExpression) {
+        re_ = QRegExp(query.text, query.caseSensitivity, QRegExp::RegExp2);
+    } else if (query.mode == SearchQuery::Fuzzy) {
+        fuzzyText_ = query.caseSensitivity == Qt::CaseInsensitive
+                ? query.text.toCaseFolded() : query.text;
+    }
+}
+
+bool RecordMatcher::isValid() const
+{
+    return query_.mode == SearchQuery::PlainText || re_.isValid();
+}
+
+bool RecordMatcher::matches(const Record &record) const
+{
+    if (query_.source >= 0 && record.source != query_.source)
+        return false;
+
+    if (record.level < query_.minLevel)
+        return false;
+
+    return matches(record.text);
+}
+
+bool RecordMatcher::matches(const QString &text) const
+{
+    if ( query_.text.isEmpty() )
+        return true;
+
+    if (query_.mode == SearchQuery::PlainText)
+        return textMatcher_.indexIn(text) != -1;
+
+    if (query_.mode == SearchQuery::Fuzzy)
+        return fuzzyScore(text) != -1;
+
+    return re_.indexIn(text) != -1;
+}
+
+int RecordMatcher::score(const Record &record) const
+{
+    if (query_.source >= 0 && record.source != query_.source)
+        return -1;
+
+    if (record.level < query_.minLevel)
+        return -1;
+
+    if ( isRanked() && !query_.text.isEmpty() )
+        return fuzzyScore(record.text);
+
+    return matches(record.text) ? 0 : -1;
+}
+
+bool RecordMatcher::refines(const RecordMatcher &previous) const
+{
+    const SearchQuery &other = previous.query_;
+    return isRanked() && previous.isRanked()
+        && query_.caseSensitivity == other.caseSensitivity
+        && query_.source == other.source
+        && query_.minLevel == other.minLevel
+        && isSubsequence(previous.fuzzyText_, fuzzyText_);
+}
+
+int RecordMatcher::fuzzyScore(const QString &text) const
+{
+    const QString &pattern = fuzzyText_;
+    const Qt::CaseSensitivity cs = query_.caseSensitivity;
+
+    // Find end of first occurrence of pattern characters.
+    int end = -1;
+    for (int i = 0, j = 0; i < text.size(); ++i) {
+        if ( foldCase(text[i], cs) == pattern[j] && ++j == pattern.size() ) {
+            end = i;
+            break;
+        }
+    }
+
+    if (end == -1)
+        return -1;
+
+    // Find shortest occurrence ending there.
+    int start = end;
+    for (int i = end, j = pattern.size() - 1; i >= 0; --i) {
+        if ( foldCase(text[i], cs) == pattern[j] && --j < 0 ) {
+            start = i;
+            break;
+        }
+    }
+
+    int score = -qMin(start, fuzzyMaxStartPenalty);
+    int consecutive = 0;
+    for (int i = start, j = 0; i <= end; ++i) {
+        if ( j < pattern.size() && foldCase(text[i], cs) == pattern[j] ) {
+            score += fuzzyMatchScore + qMin(consecutive, 4) * fuzzyConsecutiveBonus;
+            if ( isWordStart(text, i) )
+                score += fuzzyWordStartBonus;
+            ++consecutive;
+            ++j;
+        } else {
+            // Penalty for gap.
+            consecutive = 0;
+            --score;
+        }
+    }
+
+    return qMax(0, score);
+}
+
+LogSearch::LogSearch(const RecordStore &records, const TrigramIndex &index, QObject *parent)
+    : QObject(parent)
+    , records_(records)
+    , index_(index)
+    , pool_()
+    , cancelled_()
+    , generation_(0)
+    , pendingChunks_(0)
+    , ranked_()
+    , rankedMatcher_()
+    , rankedEndId_(0)
+    , lastRankedMatcher_()
+    , lastRankedEndId_(0)
+    , lastRankedIds_()
+{
+}
+
+LogSearch::~LogSearch()
+{
+    // Tasks must not post events to destroyed object.
+    stop();
+}
+
+void LogSearch::start(const RecordMatcher &matcher, qint64 firstId, qint64 endId)
+{
+    cancel();
+
+    cancelled_ = std::make_shared< std::atomic<bool> >(false);
+
+    ranked_.clear();
+    rankedMatcher_ = matcher;
+    rankedEndId_ = endId;
+
+    QVector<qint64> candidates;
+    const SearchQuery &query = matcher.query();
+    const bool useIndex = query.mode == SearchQuery::PlainText
+            && query.caseSensitivity == Qt::CaseInsensitive
+            && index_.candidates(query.text, &candidates);
+
+    if ( refinedCandidates(matcher, firstId, endId, &candidates) ) {
+        for (int i = 0; i < candidates.size(); i += chunkSize)
+            startChunk( matcher, 0, 0, candidates.mid(i, chunkSize) );
+    } else if (useIndex) {
+        // Skip records outside the range.
+        auto begin = std::lower_bound(candidates.constBegin(), candidates.constEnd(), firstId);
+        auto end = std::lower_bound(begin, candidates.constEnd(), endId);
+        const int from = static_cast<int>( begin - candidates.constBegin() );
+        const int to = static_cast<int>( end - candidates.constBegin() );
+
+        for (int i = from; i < to; i += chunkSize)
+            startChunk( matcher, 0, 0, candidates.mid(i, qMin(chunkSize, to - i)) );
+    } else {
+        for (qint64 id = firstId; id < endId; id += chunkSize)
+            startChunk( matcher, id, qMin<qint64>(endId, id + chunkSize), QVector<qint64>() );
+    }
+
+    if (pendingChunks_ == 0) {
+        addRankedMatches( QVector<qint64>(), QVector<int>() );
+        emit finished();
+    }
+}
+
+void LogSearch::cancel()
+{
+    if (cancelled_ != nullptr)
+        *cancelled_ = true;
+
+    ++generation_;
+    pendingChunks_ = 0;
+}
+
+void LogSearch::stop()
+{
+    cancel();
+    pool_.waitForDone();
+}
+
+void LogSearch::customEvent(QEvent *event)
+{
+    if ( event->type() != chunkFinishedEventType )
+        return;
+
+    auto chunkEvent = static_cast<ChunkFinishedEvent*>(event);
+    if (chunkEvent->generation != generation_)
+        return;
+
+    --pendingChunks_;
+
+    if ( rankedMatcher_.isRanked() )
+        addRankedMatches(chunkEvent->ids, chunkEvent->scores);
+    else if ( !chunkEvent->ids.isEmpty() )
+        emit matchesFound(chunkEvent->ids);
+
+    if (pendingChunks_ == 0)
+        emit finished();
+}
+
+void LogSearch::startChunk(const RecordMatcher &matcher, qint64 firstId, qint64 endId,
+                           const QVector<qint64> &candidates)
+{
+    ++pendingChunks_;
+    pool_.start( new SearchTask(this, generation_, cancelled_, records_, matcher,
+                                firstId, endId, candidates) );
+}
+
+bool LogSearch::refinedCandidates(const RecordMatcher &matcher, qint64 firstId, qint64 endId,
+                                  QVector<qint64> *candidates) const
+{
+    if ( !matcher.refines(lastRankedMatcher_) )
+        return false;
+
+    candidates->clear();
+
+    auto begin = std::lower_bound(lastRankedIds_.constBegin(), lastRankedIds_.constEnd(), firstId);
+    auto end = std::lower_bound(begin, lastRankedIds_.constEnd(), endId);
+    for (auto it = begin; it != end; ++it)
+        candidates->append(*it);
+
+    // Records added after last search.
+    for (qint64 id = qMax(firstId, lastRankedEndId_); id < endId; ++id)
+        candidates->append(id);
+
+    return true;
+}
+
+void LogSearch::addRankedMatches(const QVector<qint64> &ids, const QVector<int> &scores)
+{
+    if ( !rankedMatcher_.isRanked() )
+        return;
+
+    // Merge matches sorted by score (ties keep lower IDs first).
+    QVector<RankedMatch> ranked;
+    ranked.reserve( ranked_.size() + ids.size() );
+    int i = 0;
+    int j = 0;
+    while ( i < ranked_.size() || j < ids.size() ) {
+        const bool takeNew = i == ranked_.size()
+                || ( j < ids.size()
+                     && (scores[j] > ranked_[i].score
+                         || (scores[j] == ranked_[i].score && ids[j] < ranked_[i].id)) );
+        if (takeNew) {
+            RankedMatch match;
+            match.id = ids[j];
+            match.score = scores[j];
+            ranked.append(match);
+            ++j;
+        } else {
+            ranked.append(ranked_[i]);
+            ++i;
+        }
+    }
+    ranked_ = ranked;
+
+    const bool finished = pendingChunks_ == 0;
+    if ( !finished && ids.isEmpty() )
+        return;
+
+    const int count = finished ? ranked_.size() : qMin(rankedPreviewSize, ranked_.size());
+    QVector<qint64> rankedIds;
+    rankedIds.reserve(count);
+    for (int k = 0; k < count; ++k)
+        rankedIds.append(ranked_[k].id);
+
+    if (finished) {
+        lastRankedMatcher_ = rankedMatcher_;
+        lastRankedEndId_ = rankedEndId_;
+        lastRankedIds_ = rankedIds;
+        std::sort( lastRankedIds_.begin(), lastRankedIds_.end() );
+    }
+
+    emit rankedMatchesFound(rankedIds);
+}
+
+} // namespace traypost
@@ -0,0 +1,203 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QRegExp>
+#include <QStringMatcher>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+namespace traypost {
+
+class RecordStore;
+class TrigramIndex;
+struct Record;
+
+struct SearchQuery {
+    enum Mode {
+        PlainText,
+        WholeWords,
+        RegularExpression,
+        /// Characters in order with gaps allowed; results are ranked.
+        Fuzzy
+    };
+
+    SearchQuery()
+        : text(), mode(PlainText), caseSensitivity(Qt::CaseInsensitive), source(-1), minLevel(0) {}
+
+    QString text;
+    Mode mode;
+    Qt::CaseSensitivity caseSensitivity;
+    /// Input of records (-1 for any).
+    int source;
+    /// Least severe Record::Level of records (0 for any, including records without level).
+    int minLevel;
+};
+
+/**
+ * Compiled search query.
+ *
+ * Matching is not thread-safe; each thread should use its own copy.
+ */
+class RecordMatcher
+{
+public:
+    /**
+     * Create matcher for empty query.
+     */
+    RecordMatcher();
+
+    explicit RecordMatcher(const SearchQuery &query);
+
+    const SearchQuery &query() const { return query_; }
+
+    bool isEmpty() const
+    {
+        return query_.text.isEmpty() && query_.source < 0 && query_.minLevel <= 0;
+    }
+
+    /**
+     * Return false if regular expression is invalid.
+     */
+    bool isValid() const;
+
+    bool matches(const Record &record) const;
+
+    bool matches(const QString &text) const;
+
+    bool isRanked() const { return query_.mode == SearchQuery::Fuzzy; }
+
+    /**
+     * Return rank of matching record (higher is better) or -1 if record
+     * doesn't match.
+     *
+     * Fuzzy match is scored by matched characters with bonuses for
+     * consecutive characters and for characters at start of words.
+     */
+    int score(const Record &record) const;
+
+    /**
+     * Return true if any record matching this query matches @a previous query
+     * (i.e. only previous results need to be searched).
+     */
+    bool refines(const RecordMatcher &previous) const;
+
+private:
+    int fuzzyScore(const QString &text) const;
+
+    SearchQuery query_;
+    QStringMatcher textMatcher_;
+    QRegExp re_;
+    /// Fuzzy query text (case-folded if case-insensitive).
+    QString fuzzyText_;
+};
+
+/**
+ * Searches records in thread pool.
+ *
+ * Records are split into chunks and matching record IDs are reported for each
+ * finished chunk. Starting new search cancels the running one.
+ *
+ * Ranked (fuzzy) matches are sorted by rank in worker threads and merged as
+ * chunks finish; best matches are reported first. If the query refines the
+ * last finished ranked query, only its matches and newer records are searched.
+ */
+class LogSearch : public QObject
+{
+    Q_OBJECT
+public:
+    LogSearch(const RecordStore &records, const TrigramIndex &index, QObject *parent = nullptr);
+
+    ~LogSearch();
+
+    /**
+     * Start searching records with IDs in range [@a firstId, @a endId).
+     */
+    void start(const RecordMatcher &matcher, qint64 firstId, qint64 endId);
+
+    void cancel();
+
+    /**
+     * Cancel search and wait for worker threads to finish (records and index
+     * can be destroyed afterwards).
+     */
+    void stop();
+
+    bool isRunning() const { return pendingChunks_ > 0; }
+
+signals:
+    /**
+     * Emitted for each searched chunk with sorted IDs of matching records.
+     */
+    void matchesFound(const QVector<qint64> &ids);
+
+    /**
+     * Emitted for ranked query with IDs of best records found so far (best
+     * first); all matches are reported when search finishes.
+     */
+    void rankedMatchesFound(const QVector<qint64> &ids);
+
+    void finished();
+
+protected:
+    void customEvent(QEvent *event);
+
+private:
+    struct RankedMatch {
+        qint64 id;
+        int score;
+    };
+
+    void startChunk(const RecordMatcher &matcher, qint64 firstId, qint64 endId,
+                    const QVector<qint64> &candidates);
+
+    /**
+     * Return candidates for refined ranked query or false if all records
+     * must be searched.
+     */
+    bool refinedCandidates(const RecordMatcher &matcher, qint64 firstId, qint64 endId,
+                           QVector<qint64> *candidates) const;
+
+    void addRankedMatches(const QVector<qint64> &ids, const QVector<int> &scores);
+
+    const RecordStore &records_;
+    const TrigramIndex &index_;
+
+    QThreadPool pool_;
+    std::shared_ptr< std::atomic<bool> > cancelled_;
+    int generation_;
+    int pendingChunks_;
+
+    /// Matches of running ranked search sorted by rank.
+    QVector<RankedMatch> ranked_;
+    RecordMatcher rankedMatcher_;
+    qint64 rankedEndId_;
+
+    /// Last finished ranked search and its matches sorted by ID.
+    RecordMatcher lastRankedMatcher_;
+    qint64 lastRankedEndId_;
+    QVector<qint64> lastRankedIds_;
+};
+
+} // namespace traypost
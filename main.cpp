@@ -18,12 +18,17 @@
 */
 
 #include "launcher.h"
+#include "post_client.h"
 
 #include <QApplication>
 #include <QThread>
 
 int main(int argc, char *argv[])
 {
+    // Post messages to daemon without starting Qt.
+    if ( traypost::hasPostOption(argc, argv) )
+        return traypost::postMessages(argc, argv);
+
     QApplication app(argc, argv);
     app.setQuitOnLastWindowClosed(false);
 
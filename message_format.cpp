@@ -0,0 +1,222 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "message_format.h"
+
+#include "record.h"
+
+#include <QCache>
+#include <QObject>
+
+#if QT_VERSION < 0x050000
+#   include <QTextDocument> // Qt::escape()
+#endif
+
+namespace traypost {
+
+namespace {
+
+/// Maximum total length of cached escaped texts.
+constexpr int escapedTextCacheSize = 4 * 1024 * 1024;
+
+/// Number of cached formatted times (each for different second).
+constexpr int timeCacheSize = 256;
+
+/// Replaces milliseconds in time format; it's not a letter so it's kept as is.
+const QChar millisecondPlaceholder(0x1);
+
+QString escapeHighlightedHtml(const Record &record)
+{
+    const QString &text = record.text;
+
+    QString result;
+    int pos = 0;
+    for (const auto &span : record.highlights) {
+        if (span.start < pos || span.start + span.length > text.size())
+            break;
+        result.append( escapeHtml(text.mid(pos, span.start - pos)) );
+        result.append("<b>");
+        result.append( escapeHtml(text.mid(span.start, span.length)) );
+        result.append("</b>");
+        pos = span.start + span.length;
+    }
+    result.append( escapeHtml(text.mid(pos)) );
+
+    return result;
+}
+
+} // namespace
+
+QString escapeHtml(const QString &str)
+{
+#if QT_VERSION < 0x050000
+    return Qt::escape(str);
+#else
+    return str.toHtmlEscaped();
+#endif
+}
+
+struct MessageFormat::Cache {
+    Cache() : escapedTexts(escapedTextCacheSize), times(timeCacheSize) {}
+
+    QCache<qint64, QString> escapedTexts;
+    /// Formatted times split by millisecond placeholders.
+    QCache<qint64, QStringList> times;
+};
+
+MessageFormat::MessageFormat()
+    : segments_()
+    , timeFormat_()
+    , millisecondDigits_()
+    , cache_(new Cache)
+{
+}
+
+MessageFormat::MessageFormat(const QString &format, const QString &timeFormat)
+    : segments_()
+    , timeFormat_()
+    , millisecondDigits_()
+    , cache_(new Cache)
+{
+    parseFormat(format);
+    parseTimeFormat(timeFormat);
+}
+
+QString MessageFormat::format(const Record &record, qint64 id) const
+{
+    QString result;
+    for (const Segment &segment : segments_) {
+        switch (segment.type) {
+        case Segment::Literal:
+            result.append(segment.literal);
+            break;
+        case Segment::Text:
+            result.append( escapedText(record, id) );
+            if (record.repeats > 1) {
+                result.append(
+                    QObject::tr(" (%n times, last %1)", "", record.repeats)
+                            .arg( formatTime(record.lastSeen) ) );
+            }
+            break;
+        case Segment::Time:
+            result.append( formatTime(record) );
+            break;
+        }
+    }
+
+    return result;
+}
+
+QString MessageFormat::formatTime(const Record &record) const
+{
+    return formatTime(record.eventTime);
+}
+
+QString MessageFormat::formatTime(qint64 ms) const
+{
+    qint64 second = ms / 1000;
+    int millisecond = static_cast<int>(ms % 1000);
+    if (millisecond < 0) {
+        millisecond += 1000;
+        --second;
+    }
+
+    QStringList *parts = cache_->times.object(second);
+    if (parts == nullptr) {
+        // Converted to local time only here, once per second.
+        const QDateTime time = QDateTime::fromMSecsSinceEpoch(second * 1000);
+        parts = new QStringList( time.toString(timeFormat_).split(millisecondPlaceholder) );
+        cache_->times.insert(second, parts);
+    }
+
+    QString result = parts->value(0);
+    for (int i = 1; i < parts->size(); ++i) {
+        const int digits = millisecondDigits_.value(i - 1, 3);
+        result.append( digits == 1 ? QString::number(millisecond)
+                                   : QString("%1").arg(millisecond, 3, 10, QChar('0')) );
+        result.append( parts->at(i) );
+    }
+
+    return result;
+}
+
+void MessageFormat::parseFormat(const QString &format)
+{
+    Segment literal;
+    literal.type = Segment::Literal;
+
+    for (int i = 0; i < format.size(); ++i) {
+        const QChar c = format[i];
+        const QChar next = i + 1 < format.size() ? format[i + 1] : QChar();
+
+        if ( c == '%' && (next == '1' || next == '2') ) {
+            if ( !literal.literal.isEmpty() ) {
+                segments_.append(literal);
+                literal.literal.clear();
+            }
+
+            Segment segment;
+            segment.type = next == '1' ? Segment::Text : Segment::Time;
+            segments_.append(segment);
+            ++i;
+        } else {
+            literal.literal.append(c);
+        }
+    }
+
+    if ( !literal.literal.isEmpty() )
+        segments_.append(literal);
+}
+
+void MessageFormat::parseTimeFormat(const QString &timeFormat)
+{
+    bool quoted = false;
+
+    for (int i = 0; i < timeFormat.size(); ++i) {
+        const QChar c = timeFormat[i];
+
+        if (c == '\'') {
+            quoted = !quoted;
+        } else if (!quoted && c == 'z') {
+            const bool threeDigits = timeFormat.mid(i, 3) == "zzz";
+            millisecondDigits_.append(threeDigits ? 3 : 1);
+            timeFormat_.append(millisecondPlaceholder);
+            if (threeDigits)
+                i += 2;
+            continue;
+        }
+
+        timeFormat_.append(c);
+    }
+}
+
+QString MessageFormat::escapedText(const Record &record, qint64 id) const
+{
+    QString *text = cache_->escapedTexts.object(id);
+    if (text != nullptr)
+        return *text;
+
+    const QString escaped = record.highlights.isEmpty()
+            ? escapeHtml(record.text)
+            : escapeHighlightedHtml(record);
+    cache_->escapedTexts.insert( id, new QString(escaped), qMax(1, escaped.size()) );
+    return escaped;
+}
+
+} // namespace traypost
@@ -0,0 +1,87 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <memory>
+
+namespace traypost {
+
+struct Record;
+
+/**
+ * Escape HTML special characters in text.
+ */
+QString escapeHtml(const QString &str);
+
+/**
+ * Formats records as HTML.
+ *
+ * Message format (%1 is message, %2 is time) and time format are parsed only
+ * once. Escaped texts (by record ID) and formatted times (by second) are
+ * cached.
+ *
+ * Repeated records have repeat count and time of last repeat appended to
+ * the text. Highlighted parts of text are bold.
+ *
+ * Copies share the caches so these must be used only in single thread.
+ */
+class MessageFormat
+{
+public:
+    MessageFormat();
+
+    MessageFormat(const QString &format, const QString &timeFormat);
+
+    QString format(const Record &record, qint64 id) const;
+
+    QString formatTime(const Record &record) const;
+
+private:
+    QString formatTime(qint64 ms) const;
+
+    struct Segment {
+        enum Type { Literal, Text, Time };
+        Type type;
+        QString literal;
+    };
+
+    struct Cache;
+
+    void parseFormat(const QString &format);
+
+    void parseTimeFormat(const QString &timeFormat);
+
+    QString escapedText(const Record &record, qint64 id) const;
+
+    QVector<Segment> segments_;
+
+    /// Time format with milliseconds replaced by placeholder.
+    QString timeFormat_;
+    /// Number of digits for each millisecond placeholder (1 for no leading zeros).
+    QVector<int> millisecondDigits_;
+
+    std::shared_ptr<Cache> cache_;
+};
+
+} // namespace traypost
@@ -0,0 +1,139 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "notification_scheduler.h"
+#include "statistics.h"
+
+namespace traypost {
+
+namespace {
+
+constexpr qint64 budgetPeriod = 60 * 1000;
+
+} // namespace
+
+NotificationScheduler::NotificationScheduler(QObject *parent)
+    : QObject(parent)
+    , debounce_(1000)
+    , maxDelay_(5000)
+    , budget_(10)
+    , clock_()
+    , timer_()
+    , pending_(0)
+    , firstPendingTime_(0)
+    , lastRecordTime_(0)
+    , timerDueTime_(0)
+    , blockedUntil_(0)
+    , postponed_(false)
+    , notificationTimes_()
+{
+    clock_.start();
+    timer_.setSingleShot(true);
+    connect( &timer_, SIGNAL(timeout()), SLOT(onTimeout()) );
+}
+
+void NotificationScheduler::setDebounce(int ms)
+{
+    debounce_ = qMax(0, ms);
+}
+
+void NotificationScheduler::setMaxDelay(int ms)
+{
+    maxDelay_ = qMax(0, ms);
+}
+
+void NotificationScheduler::setBudget(int notificationsPerMinute)
+{
+    budget_ = qMax(0, notificationsPerMinute);
+}
+
+void NotificationScheduler::addRecords(int count)
+{
+    if (count <= 0)
+        return;
+
+    lastRecordTime_ = clock_.elapsed();
+    if (pending_ == 0)
+        firstPendingTime_ = lastRecordTime_;
+    pending_ += count;
+
+    schedule();
+}
+
+void NotificationScheduler::reset()
+{
+    pending_ = 0;
+    postponed_ = false;
+    timer_.stop();
+}
+
+void NotificationScheduler::onTimeout()
+{
+    if (pending_ == 0)
+        return;
+
+    const qint64 now = clock_.elapsed();
+
+    // New records may have arrived since the timer was started.
+    if ( now < dueTime() ) {
+        schedule();
+        return;
+    }
+
+    while ( !notificationTimes_.isEmpty() && now - notificationTimes_.head() >= budgetPeriod )
+        notificationTimes_.dequeue();
+
+    if ( budget_ > 0 && notificationTimes_.size() >= budget_ ) {
+        // Wait until oldest notification is out of budget period.
+        if (!postponed_) {
+            postponed_ = true;
+            ++Statistics::global().notificationsPostponed;
+        }
+        blockedUntil_ = notificationTimes_.head() + budgetPeriod;
+        schedule();
+        return;
+    }
+
+    notificationTimes_.enqueue(now);
+
+    const int count = pending_;
+    pending_ = 0;
+    postponed_ = false;
+    emit notify(count);
+}
+
+qint64 NotificationScheduler::dueTime() const
+{
+    const qint64 due = qMin(lastRecordTime_ + debounce_, firstPendingTime_ + maxDelay_);
+    return qMax(due, blockedUntil_);
+}
+
+void NotificationScheduler::schedule()
+{
+    const qint64 due = dueTime();
+
+    // Avoid restarting the timer for each record; onTimeout() checks again.
+    if ( timer_.isActive() && timerDueTime_ <= due )
+        return;
+
+    timerDueTime_ = due;
+    timer_.start( static_cast<int>(qMax<qint64>(0, due - clock_.elapsed())) );
+}
+
+} // namespace traypost
@@ -0,0 +1,103 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+
+namespace traypost {
+
+/**
+ * Decides when to show notification for new records.
+ *
+ * Notification is shown after there are no new records for some time
+ * (debounce) but at most after given maximum delay since the first record not
+ * yet notified. If the budget of notifications per minute is exhausted, the
+ * records are collected and notified together later.
+ */
+class NotificationScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NotificationScheduler(QObject *parent = nullptr);
+
+    /**
+     * Set time without new records after which notification is shown.
+     */
+    void setDebounce(int ms);
+
+    /**
+     * Set maximum delay of notification after first new record.
+     */
+    void setMaxDelay(int ms);
+
+    /**
+     * Set maximum number of notifications per minute (zero for no limit).
+     */
+    void setBudget(int notificationsPerMinute);
+
+    /**
+     * Schedule notification for new records.
+     */
+    void addRecords(int count = 1);
+
+    /**
+     * Forget records not yet notified.
+     */
+    void reset();
+
+signals:
+    /**
+     * Show notification for @a count new records.
+     */
+    void notify(int count);
+
+private slots:
+    void onTimeout();
+
+private:
+    /**
+     * Return time when pending records should be notified.
+     */
+    qint64 dueTime() const;
+
+    void schedule();
+
+    int debounce_;
+    int maxDelay_;
+    int budget_;
+
+    QElapsedTimer clock_;
+    QTimer timer_;
+
+    int pending_;
+    qint64 firstPendingTime_;
+    qint64 lastRecordTime_;
+    qint64 timerDueTime_;
+    qint64 blockedUntil_;
+    bool postponed_;
+
+    /// Times of notifications in last minute.
+    QQueue<qint64> notificationTimes_;
+};
+
+} // namespace traypost
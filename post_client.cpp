@@ -0,0 +1,218 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "post_client.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace traypost {
+
+namespace {
+
+std::string privateSocketDirectory()
+{
+    return "/tmp/traypost-" + std::to_string( static_cast<long long>(getuid()) );
+}
+
+bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        // Report EPIPE instead of being killed if daemon closes connection.
+        const ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+/**
+ * Post message as single record (messages are terminated by NUL character so
+ * they can contain new lines).
+ */
+bool postMessage(int fd, std::string message)
+{
+    if ( !message.empty() && message[message.size() - 1] == '\n' )
+        message.erase(message.size() - 1);
+    message.push_back('\0');
+    return writeAll( fd, message.data(), message.size() );
+}
+
+/**
+ * Post each line from standard input as separate message.
+ */
+bool postStandardInput(int fd)
+{
+    char buffer[64 * 1024];
+    bool terminated = true;
+    for (;;) {
+        const ssize_t size = ::read(0, buffer, sizeof(buffer));
+        if (size == 0)
+            return terminated || writeAll(fd, "", 1);
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        for (ssize_t i = 0; i < size; ++i) {
+            if (buffer[i] == '\n')
+                buffer[i] = '\0';
+        }
+        terminated = buffer[size - 1] == '\0';
+
+        if ( !writeAll(fd, buffer, size) )
+            return false;
+    }
+}
+
+int fail(const std::string &message)
+{
+    std::cerr << message << std::endl;
+    return 2;
+}
+
+} // namespace
+
+std::string defaultSocketPath()
+{
+    const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir != nullptr && runtimeDir[0] != '\0')
+        return std::string(runtimeDir) + "/traypost.sock";
+
+    return privateSocketDirectory() + "/traypost.sock";
+}
+
+bool checkSocketDirectory(const std::string &socketPath, bool create)
+{
+    const std::string dir = privateSocketDirectory();
+    if ( socketPath.compare(0, dir.size() + 1, dir + "/") != 0 )
+        return true;
+
+    if ( create && ::mkdir(dir.c_str(), S_IRWXU) != 0 && errno != EEXIST )
+        return false;
+
+    // Other users can create the directory in /tmp first.
+    struct stat st;
+    if ( ::lstat(dir.c_str(), &st) != 0 )
+        return false;
+    if ( !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & (S_IRWXG | S_IRWXO)) != 0 ) {
+        errno = EACCES;
+        return false;
+    }
+
+    return true;
+}
+
+int connectToDaemon(const std::string &socketPath)
+{
+    struct sockaddr_un address;
+    if ( socketPath.size() >= sizeof(address.sun_path) ) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy( address.sun_path, socketPath.data(), socketPath.size() );
+
+    if ( ::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ) {
+        const int error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+
+    return fd;
+}
+
+int postMessages(int argc, char *argv[])
+{
+    std::string socketPath = defaultSocketPath();
+    std::vector<std::string> messages;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ( arg.compare(0, 2, "--") != 0 ) {
+            messages.push_back(arg);
+            continue;
+        }
+
+        const size_t eq = arg.find('=');
+        const std::string name = arg.substr(0, eq);
+        if (name != "--post" && name != "--socket")
+            return fail("Unknown option \"" + name + "\" (only --post and --socket can be used).");
+
+        std::string value;
+        if (eq != std::string::npos)
+            value = arg.substr(eq + 1);
+        else if (i + 1 < argc)
+            value = argv[++i];
+        else
+            return fail("Option " + name + " needs value.");
+
+        if (name == "--post")
+            messages.push_back(value);
+        else
+            socketPath = value;
+    }
+
+    if ( !checkSocketDirectory(socketPath, false) )
+        return fail( "Unsafe socket directory for \"" + socketPath + "\": " + strerror(errno) );
+
+    const int fd = connectToDaemon(socketPath);
+    if (fd == -1)
+        return fail( "Cannot connect to \"" + socketPath + "\": " + strerror(errno) );
+
+    bool ok = true;
+    for (const auto &message : messages) {
+        ok = message == "-" ? postStandardInput(fd) : postMessage(fd, message);
+        if (!ok)
+            break;
+    }
+
+    const int error = errno;
+    ::close(fd);
+
+    if (!ok)
+        return fail( std::string("Cannot post message: ") + strerror(error) );
+
+    return 0;
+}
+
+} // namespace traypost
@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Doesn't depend on Qt so messages can be posted without starting Qt.
+
+#include <string>
+
+namespace traypost {
+
+/**
+ * Return path of daemon socket ("$XDG_RUNTIME_DIR/traypost.sock" or
+ * "/tmp/traypost-<uid>/traypost.sock").
+ */
+std::string defaultSocketPath();
+
+/**
+ * Check that directory of default socket in "/tmp" is private to the user.
+ *
+ * Does nothing for other socket paths.
+ *
+ * @param create create the directory if it doesn't exist
+ * @return false if directory cannot be created or is accessible by others
+ *         (errno is set)
+ */
+bool checkSocketDirectory(const std::string &socketPath, bool create);
+
+/**
+ * Connect to daemon socket.
+ * @return socket file descriptor or -1 on error (errno is set)
+ */
+int connectToDaemon(const std::string &socketPath);
+
+/**
+ * Post messages from command line to daemon.
+ *
+ * Arguments: [--socket PATH] [--post] MESSAGE...
+ * Message "-" posts lines from standard input as separate messages; other
+ * messages can contain new lines.
+ *
+ * @return exit code
+ */
+int postMessages(int argc, char *argv[]);
+
+} // namespace traypost
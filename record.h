@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QDateTime>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+#include <time.h>
+
+namespace traypost {
+
+/**
+ * Part of text (positions are in UTF-16 code units).
+ */
+struct TextSpan {
+    int start;
+    int length;
+};
+
+struct Record {
+    /// Severity parsed from structured input (ordered from least severe).
+    enum Level {
+        NoLevel,
+        DebugLevel,
+        InfoLevel,
+        WarningLevel,
+        ErrorLevel
+    };
+
+    Record()
+        : text(), time(0), eventTime(0), lastSeen(0), repeats(1), source(0), level(NoLevel)
+        , highlights() {}
+    Record(const QString &text, qint64 time = currentTime())
+        : text(text), time(time), eventTime(time), lastSeen(time), repeats(1), source(0)
+        , level(NoLevel), highlights() {}
+
+    /**
+     * Return current time in milliseconds since epoch (UTC).
+     *
+     * This is much faster than QDateTime::currentDateTime() which also
+     * converts to local time.
+     */
+    static qint64 currentTime()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<qint64>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    /**
+     * Return event time converted to local time.
+     */
+    QDateTime localTime() const { return QDateTime::fromMSecsSinceEpoch(eventTime); }
+
+    QString text;
+    /// Arrival time in milliseconds since epoch (UTC); used for eviction.
+    qint64 time;
+    /// Time parsed from structured input (same as time if not available).
+    qint64 eventTime;
+    /// Time of last consecutive repeat of the text (same as time if not repeated).
+    qint64 lastSeen;
+    /// Number of consecutive occurrences of the text.
+    int repeats;
+    /// Index of input (or source field in structured input) the record was read from.
+    int source;
+    Level level;
+    /// Sorted non-overlapping parts of text matching highlighted keywords.
+    QVector<TextSpan> highlights;
+};
+
+} // namespace traypost
+
+Q_DECLARE_TYPEINFO(traypost::TextSpan, Q_PRIMITIVE_TYPE);
+
+Q_DECLARE_METATYPE(traypost::Record)
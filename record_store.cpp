@@ -0,0 +1,348 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "record_store.h"
+
+#include <QRunnable>
+#include <QThread>
+
+#include <cstring>
+
+namespace traypost {
+
+namespace {
+
+constexpr int initialCapacity = 64;
+
+/// Size of chunk for record texts (bigger texts get chunk of their own).
+constexpr int chunkSize = 1024 * 1024;
+
+constexpr int maxHighlights = 255;
+
+/**
+ * Return total size of cached decompressed chunks in KiB.
+ *
+ * Each thread searching records in parallel needs its own chunk cached,
+ * otherwise the threads would keep decompressing each other's chunks.
+ */
+int decompressedCacheSize()
+{
+    const int chunks = qMax(4, 2 * QThread::idealThreadCount());
+    return chunks * (chunkSize / 1024);
+}
+
+} // namespace
+
+RecordStore::RecordStore()
+    : count_(0)
+    , firstId_(0)
+    , bytes_(0)
+    , extraBytes_(0)
+    , maxRecords_(0)
+    , maxBytes_(0)
+    , maxAge_(0)
+    , lock_()
+{
+}
+
+RecordStore::~RecordStore()
+{
+}
+
+void RecordStore::setLimits(int maxRecords, qint64 maxBytes, qint64 maxAge)
+{
+    maxRecords_ = maxRecords;
+    maxBytes_ = maxBytes;
+    maxAge_ = maxAge;
+}
+
+void RecordStore::setExtraBytes(qint64 bytes)
+{
+    QWriteLocker lock(&lock_);
+    extraBytes_ = bytes;
+}
+
+bool RecordStore::append(const Record &record)
+{
+    QWriteLocker lock(&lock_);
+    const qint64 size = appendRecord(record);
+    if (size < 0)
+        return false;
+    bytes_ += size;
+    ++count_;
+    return true;
+}
+
+void RecordStore::repeatLast(int count, qint64 lastSeen)
+{
+    QWriteLocker lock(&lock_);
+    if (count_ > 0)
+        addRepeats(count_ - 1, count, lastSeen);
+}
+
+int RecordStore::evict()
+{
+    QWriteLocker lock(&lock_);
+    int removed = 0;
+
+    while ( maxRecords_ > 0 && count_ > maxRecords_ ) {
+        removeFirst();
+        ++removed;
+    }
+
+    // Always keep last record.
+    while ( maxBytes_ > 0 && bytes_ + extraBytes_ > maxBytes_ && count_ > 1 ) {
+        removeFirst();
+        ++removed;
+    }
+
+    if (maxAge_ > 0) {
+        const qint64 now = Record::currentTime();
+        while ( count_ > 0 && now - recordTime(0) > maxAge_ ) {
+            removeFirst();
+            ++removed;
+        }
+    }
+
+    return removed;
+}
+
+bool RecordStore::recordById(qint64 id, Record *record) const
+{
+    QReadLocker lock(&lock_);
+
+    const qint64 row = id - firstId_;
+    if (row < 0 || row >= count_)
+        return false;
+
+    *record = recordAt( static_cast<int>(row) );
+    return true;
+}
+
+void RecordStore::removeFirst()
+{
+    bytes_ -= removeFirstRecord();
+    --count_;
+    ++firstId_;
+}
+
+QByteArray RecordStore::recordData(const Record &record, int *highlightCount)
+{
+    QByteArray data = record.text.toUtf8();
+
+    *highlightCount = qMin(maxHighlights, record.highlights.size());
+    if (*highlightCount > 0) {
+        data.append( reinterpret_cast<const char*>(record.highlights.constData()),
+                     *highlightCount * static_cast<int>(sizeof(TextSpan)) );
+    }
+
+    return data;
+}
+
+void RecordStore::readRecordData(const char *data, int size, int highlightCount, Record *record)
+{
+    const int spansSize = highlightCount * static_cast<int>(sizeof(TextSpan));
+    record->text = QString::fromUtf8(data, size - spansSize);
+
+    if (highlightCount > 0) {
+        record->highlights.resize(highlightCount);
+        memcpy( record->highlights.data(), data + size - spansSize, spansSize );
+    }
+}
+
+class MemoryRecordStore::CompressTask : public QRunnable
+{
+public:
+    CompressTask(MemoryRecordStore *store, qint64 chunk, const QByteArray &data)
+        : store_(store)
+        , chunk_(chunk)
+        , data_(data)
+    {
+    }
+
+    void run()
+    {
+        store_->setCompressedChunk( chunk_, qCompress(data_) );
+    }
+
+private:
+    MemoryRecordStore *store_;
+    qint64 chunk_;
+    QByteArray data_;
+};
+
+MemoryRecordStore::MemoryRecordStore()
+    : ring_(initialCapacity)
+    , head_(0)
+    , count_(0)
+    , mask_(initialCapacity - 1)
+    , chunks_()
+    , firstChunk_(0)
+    , chunksMutex_()
+    , decompressed_( decompressedCacheSize() )
+    , compressPool_()
+{
+    compressPool_.setMaxThreadCount(1);
+}
+
+MemoryRecordStore::~MemoryRecordStore()
+{
+    compressPool_.waitForDone();
+}
+
+qint64 MemoryRecordStore::appendRecord(const Record &record)
+{
+    if ( count_ == ring_.size() )
+        grow();
+
+    int highlightCount;
+    const QByteArray text = recordData(record, &highlightCount);
+
+    QMutexLocker lock(&chunksMutex_);
+
+    if ( chunks_.isEmpty() || chunks_.last().data.size() + text.size() > chunkSize ) {
+        // Compress full chunk in background.
+        if ( !chunks_.isEmpty() ) {
+            const qint64 chunk = firstChunk_ + chunks_.size() - 1;
+            compressPool_.start( new CompressTask(this, chunk, chunks_.last().data) );
+        }
+
+        chunks_.enqueue( Chunk() );
+        chunks_.last().data.reserve( qMax(chunkSize, text.size()) );
+    }
+
+    QByteArray &chunk = chunks_.last().data;
+
+    Entry &entry = ring_[(head_ + count_) & mask_];
+    entry.time = record.time;
+    entry.eventTime = record.eventTime;
+    entry.lastSeen = record.lastSeen;
+    entry.repeats = record.repeats;
+    entry.source = static_cast<quint16>(record.source);
+    entry.level = static_cast<quint8>(record.level);
+    entry.highlights = static_cast<quint8>(highlightCount);
+    entry.chunk = firstChunk_ + chunks_.size() - 1;
+    entry.offset = chunk.size();
+    entry.length = text.size();
+
+    chunk.append(text);
+    ++count_;
+
+    return sizeof(Entry) + entry.length;
+}
+
+qint64 MemoryRecordStore::removeFirstRecord()
+{
+    const qint64 bytes = sizeof(Entry) + ring_[head_].length;
+
+    head_ = (head_ + 1) & mask_;
+    --count_;
+
+    // Release chunks without any records.
+    QMutexLocker lock(&chunksMutex_);
+    const qint64 firstUsedChunk = count_ > 0 ? entry(0).chunk : firstChunk_ + chunks_.size();
+    while (firstChunk_ < firstUsedChunk) {
+        chunks_.dequeue();
+        decompressed_.remove(firstChunk_);
+        ++firstChunk_;
+    }
+
+    return bytes;
+}
+
+void MemoryRecordStore::addRepeats(int row, int count, qint64 lastSeen)
+{
+    Entry &e = entry(row);
+    e.repeats += count;
+    e.lastSeen = lastSeen;
+}
+
+Record MemoryRecordStore::recordAt(int row) const
+{
+    const Entry &e = entry(row);
+
+    Record record;
+    record.time = e.time;
+    record.eventTime = e.eventTime;
+    record.lastSeen = e.lastSeen;
+    record.repeats = e.repeats;
+    record.source = e.source;
+    record.level = static_cast<Record::Level>(e.level);
+
+    // Decode text without lock (the copy shares data with chunk or cache).
+    const QByteArray data = chunkData(e.chunk);
+    readRecordData(data.constData() + e.offset, e.length, e.highlights, &record);
+
+    return record;
+}
+
+void MemoryRecordStore::grow()
+{
+    QVector<Entry> ring( ring_.size() * 2 );
+    for (int i = 0; i < count_; ++i)
+        ring[i] = entry(i);
+
+    ring_.swap(ring);
+    head_ = 0;
+    mask_ = ring_.size() - 1;
+}
+
+void MemoryRecordStore::setCompressedChunk(qint64 chunk, const QByteArray &data)
+{
+    QMutexLocker lock(&chunksMutex_);
+
+    // Chunk can be already released.
+    if (chunk < firstChunk_)
+        return;
+
+    Chunk &c = chunks_[static_cast<int>(chunk - firstChunk_)];
+    c.data = data;
+    c.compressed = true;
+}
+
+QByteArray MemoryRecordStore::chunkData(qint64 chunk) const
+{
+    QByteArray compressed;
+    {
+        QMutexLocker lock(&chunksMutex_);
+
+        const Chunk &c = chunks_[static_cast<int>(chunk - firstChunk_)];
+        if (!c.compressed)
+            return c.data;
+
+        QByteArray *data = decompressed_.object(chunk);
+        if (data != nullptr)
+            return *data;
+
+        compressed = c.data;
+    }
+
+    // Decompress without lock so other threads can access records meanwhile.
+    const QByteArray result = qUncompress(compressed);
+
+    QMutexLocker lock(&chunksMutex_);
+    // Chunk can be released or decompressed by other thread meanwhile.
+    if ( chunk >= firstChunk_ && !decompressed_.contains(chunk) ) {
+        const int cost = qBound( 1, result.size() / 1024, decompressed_.maxCost() );
+        decompressed_.insert( chunk, new QByteArray(result), cost );
+    }
+    return result;
+}
+
+} // namespace traypost
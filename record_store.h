@@ -0,0 +1,238 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "record.h"
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <QQueue>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <QVector>
+
+namespace traypost {
+
+/**
+ * Keeps records and removes oldest records exceeding limits.
+ *
+ * Each record appended gets unique ID (IDs are increasing by one) so evicted
+ * records can be recognized.
+ *
+ * Store must be modified and accessed by row only from single thread; other
+ * threads can use recordById().
+ */
+class RecordStore
+{
+public:
+    RecordStore();
+
+    virtual ~RecordStore();
+
+    /**
+     * Set maximum number of records, total size of records and maximum record
+     * age in milliseconds (zero for no limit).
+     */
+    void setLimits(int maxRecords, qint64 maxBytes, qint64 maxAge);
+
+    /**
+     * Set size of other structures kept for records (e.g. search index) which
+     * counts towards maximum total size.
+     */
+    void setExtraBytes(qint64 bytes);
+
+    /**
+     * Append record.
+     * @return false if record cannot be stored (record is dropped)
+     */
+    bool append(const Record &record);
+
+    /**
+     * Add @a count repeats to last record (last seen at @a lastSeen).
+     */
+    void repeatLast(int count, qint64 lastSeen);
+
+    /**
+     * Remove oldest records exceeding limits.
+     * @return number of removed records
+     */
+    int evict();
+
+    int size() const { return count_; }
+
+    bool isEmpty() const { return count_ == 0; }
+
+    Record at(int row) const { return recordAt(row); }
+
+    Record operator[](int row) const { return recordAt(row); }
+
+    Record last() const { return recordAt(count_ - 1); }
+
+    /**
+     * Get record with given ID (safe to call from any thread).
+     * @return false if record is not available
+     */
+    bool recordById(qint64 id, Record *record) const;
+
+    /**
+     * Return ID of first record.
+     */
+    qint64 firstId() const { return firstId_; }
+
+    /**
+     * Return ID for next appended record.
+     */
+    qint64 nextId() const { return firstId_ + count_; }
+
+    /**
+     * Return approximate size of records in bytes.
+     */
+    qint64 bytes() const { return bytes_; }
+
+protected:
+    /**
+     * Store new record.
+     * @return size of record or -1 on error
+     */
+    virtual qint64 appendRecord(const Record &record) = 0;
+
+    /**
+     * Remove first record.
+     * @return size of removed record
+     */
+    virtual qint64 removeFirstRecord() = 0;
+
+    virtual void addRepeats(int row, int count, qint64 lastSeen) = 0;
+
+    virtual Record recordAt(int row) const = 0;
+
+    virtual qint64 recordTime(int row) const { return recordAt(row).time; }
+
+    /**
+     * Return UTF-8 text of record followed by its highlights (at most 255).
+     */
+    static QByteArray recordData(const Record &record, int *highlightCount);
+
+    /**
+     * Set text and highlights of record from data created by recordData().
+     */
+    static void readRecordData(const char *data, int size, int highlightCount, Record *record);
+
+private:
+    void removeFirst();
+
+    int count_;
+    qint64 firstId_;
+    qint64 bytes_;
+    qint64 extraBytes_;
+
+    int maxRecords_;
+    qint64 maxBytes_;
+    qint64 maxAge_;
+
+    mutable QReadWriteLock lock_;
+};
+
+/**
+ * Keeps records in memory.
+ *
+ * Record texts are stored as UTF-8 in large append-only chunks and decoded
+ * only when accessed. Chunks are released once all their records are evicted.
+ *
+ * Full chunks are compressed in background and decompressed on access (last
+ * few decompressed chunks are cached).
+ */
+class MemoryRecordStore : public RecordStore
+{
+public:
+    MemoryRecordStore();
+
+    ~MemoryRecordStore();
+
+protected:
+    qint64 appendRecord(const Record &record);
+
+    qint64 removeFirstRecord();
+
+    void addRepeats(int row, int count, qint64 lastSeen);
+
+    Record recordAt(int row) const;
+
+    qint64 recordTime(int row) const { return entry(row).time; }
+
+private:
+    /// Position of record text in chunks.
+    struct Entry {
+        qint64 time;
+        qint64 eventTime;
+        qint64 lastSeen;
+        qint64 chunk;
+        int offset;
+        int length;
+        int repeats;
+        // Keep entry at 48 bytes.
+        quint16 source;
+        quint8 level;
+        quint8 highlights;
+    };
+
+    struct Chunk {
+        Chunk() : data(), compressed(false) {}
+        /// UTF-8 texts (compressed with qCompress() if chunk is full).
+        QByteArray data;
+        bool compressed;
+    };
+
+    class CompressTask;
+
+    const Entry &entry(int row) const { return ring_[(head_ + row) & mask_]; }
+
+    Entry &entry(int row) { return ring_[(head_ + row) & mask_]; }
+
+    void grow();
+
+    /**
+     * Replace chunk data with compressed data (called from compression task).
+     */
+    void setCompressedChunk(qint64 chunk, const QByteArray &data);
+
+    /**
+     * Return uncompressed data of chunk (safe to call from any thread).
+     */
+    QByteArray chunkData(qint64 chunk) const;
+
+    QVector<Entry> ring_;
+    int head_;
+    int count_;
+    int mask_;
+
+    QQueue<Chunk> chunks_;
+    /// Index of first chunk in queue (increasing as chunks are released).
+    qint64 firstChunk_;
+
+    /// Guards chunks modified by compression tasks and accessed by any thread.
+    mutable QMutex chunksMutex_;
+    /// Recently decompressed chunks (by index).
+    mutable QCache<qint64, QByteArray> decompressed_;
+    QThreadPool compressPool_;
+};
+
+} // namespace traypost
@@ -0,0 +1,211 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "statistics.h"
+
+#include "record.h"
+
+#include <QFile>
+
+namespace traypost {
+
+namespace {
+
+/// Interval for computing rates.
+constexpr int updateInterval = 1000;
+
+QString jsonString(const QString &text)
+{
+    QString result("\"");
+    for (const QChar &c : text) {
+        if (c == '"' || c == '\\')
+            result.append('\\').append(c);
+        else if (c.unicode() < 0x20)
+            result.append( QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0')) );
+        else
+            result.append(c);
+    }
+    return result.append('"');
+}
+
+} // namespace
+
+Statistics::Statistics()
+    : linesRead(0)
+    , linesFolded(0)
+    , linesDeduplicated(0)
+    , linesFiltered(0)
+    , filterPatterns()
+    , filterHits()
+    , pendingBatches(0)
+    , iconRenders(0)
+    , notificationsShown(0)
+    , notificationsPostponed(0)
+    , recordsDropped(0)
+    , records(0)
+    , recordBytes(0)
+{
+}
+
+Statistics &Statistics::global()
+{
+    static Statistics stats;
+    return stats;
+}
+
+void Statistics::setFilters(const QStringList &patterns)
+{
+    filterPatterns = patterns;
+    filterHits.reset( new std::atomic<qint64>[patterns.size()] );
+    for (int i = 0; i < patterns.size(); ++i)
+        filterHits[i] = 0;
+}
+
+StatisticsReporter::StatisticsReporter(QObject *parent)
+    : QObject(parent)
+    , stats_( Statistics::global() )
+    , timerUpdate_()
+    , lastUpdate_()
+    , lastLines_(0)
+    , lastIconRenders_(0)
+    , linesPerSecond_(0)
+    , peakLinesPerSecond_(0)
+    , iconRendersPerSecond_(0)
+    , reportInterval_(0)
+    , lastReport_()
+    , file_()
+{
+    lastUpdate_.start();
+    timerUpdate_.setInterval(updateInterval);
+    connect( &timerUpdate_, SIGNAL(timeout()), SLOT(update()) );
+    timerUpdate_.start();
+}
+
+StatisticsReporter::~StatisticsReporter()
+{
+}
+
+bool StatisticsReporter::startReporting(int interval, const QString &fileName)
+{
+    file_.reset( new QFile(fileName) );
+    const bool opened = fileName.isEmpty()
+            ? file_->open(stderr, QIODevice::WriteOnly)
+            : file_->open(QIODevice::WriteOnly | QIODevice::Append);
+
+    if (!opened) {
+        file_.reset();
+        return false;
+    }
+
+    reportInterval_ = interval;
+    lastReport_.start();
+    if (interval < updateInterval)
+        timerUpdate_.setInterval(interval);
+
+    return true;
+}
+
+QString StatisticsReporter::summary() const
+{
+    QString filters;
+    if ( !stats_.filterPatterns.isEmpty() ) {
+        filters = tr("\nLines filtered: %1").arg(stats_.linesFiltered);
+        for (int i = 0; i < stats_.filterPatterns.size(); ++i)
+            filters.append( QString("\n  %1: %2").arg(stats_.filterPatterns[i]).arg(stats_.filterHits[i]) );
+    }
+
+    return tr("Lines read: %1\n"
+              "Lines per second: %2 (peak %3)\n"
+              "Batches waiting: %4\n"
+              "Icon renders per second: %5\n"
+              "Notifications shown: %6\n"
+              "Notifications postponed: %7\n"
+              "Records: %8\n"
+              "Records size: %9 MiB")
+            .arg(stats_.linesRead)
+            .arg(linesPerSecond_, 0, 'f', 1)
+            .arg(peakLinesPerSecond_, 0, 'f', 1)
+            .arg(stats_.pendingBatches)
+            .arg(iconRendersPerSecond_, 0, 'f', 1)
+            .arg(stats_.notificationsShown)
+            .arg(stats_.notificationsPostponed)
+            .arg(stats_.records)
+            .arg(stats_.recordBytes / (1024.0 * 1024.0), 0, 'f', 1)
+            + tr("\nLines folded: %1\nLines deduplicated: %2\nRecords dropped: %3")
+            .arg(stats_.linesFolded)
+            .arg(stats_.linesDeduplicated)
+            .arg(stats_.recordsDropped)
+            + filters;
+}
+
+QString StatisticsReporter::toJson() const
+{
+    QString filters;
+    if ( !stats_.filterPatterns.isEmpty() ) {
+        QStringList hits;
+        for (int i = 0; i < stats_.filterPatterns.size(); ++i)
+            hits.append( jsonString(stats_.filterPatterns[i]) + ": " + QString::number(stats_.filterHits[i]) );
+        filters = QString(", \"lines_filtered\": %1, \"filter_hits\": {%2}")
+                .arg(stats_.linesFiltered)
+                .arg( hits.join(", ") );
+    }
+
+    return QString("{\"time\": %1, \"lines\": %2, \"lines_per_second\": %3"
+                   ", \"peak_lines_per_second\": %4, \"queue_depth\": %5"
+                   ", \"icon_renders_per_second\": %6, \"notifications_shown\": %7"
+                   ", \"notifications_postponed\": %8, \"records\": %9")
+            .arg( Record::currentTime() )
+            .arg(stats_.linesRead)
+            .arg(linesPerSecond_, 0, 'f', 1)
+            .arg(peakLinesPerSecond_, 0, 'f', 1)
+            .arg(stats_.pendingBatches)
+            .arg(iconRendersPerSecond_, 0, 'f', 1)
+            .arg(stats_.notificationsShown)
+            .arg(stats_.notificationsPostponed)
+            .arg(stats_.records)
+            + QString(", \"bytes\": %1, \"lines_folded\": %2, \"lines_deduplicated\": %3"
+                      ", \"records_dropped\": %4")
+            .arg(stats_.recordBytes)
+            .arg(stats_.linesFolded)
+            .arg(stats_.linesDeduplicated)
+            .arg(stats_.recordsDropped)
+            + filters + "}";
+}
+
+void StatisticsReporter::update()
+{
+    const double seconds = qMax<qint64>(1, lastUpdate_.restart()) / 1000.0;
+
+    const qint64 lines = stats_.linesRead;
+    linesPerSecond_ = (lines - lastLines_) / seconds;
+    peakLinesPerSecond_ = qMax(peakLinesPerSecond_, linesPerSecond_);
+    lastLines_ = lines;
+
+    const qint64 iconRenders = stats_.iconRenders;
+    iconRendersPerSecond_ = (iconRenders - lastIconRenders_) / seconds;
+    lastIconRenders_ = iconRenders;
+
+    if ( file_ != nullptr && lastReport_.elapsed() + updateInterval / 10 >= reportInterval_ ) {
+        lastReport_.restart();
+        file_->write( toJson().toUtf8() + '\n' );
+        file_->flush();
+    }
+}
+
+} // namespace traypost
@@ -0,0 +1,123 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+
+class QFile;
+
+namespace traypost {
+
+/**
+ * Runtime counters shared by reader thread and GUI.
+ */
+struct Statistics {
+    Statistics();
+
+    /**
+     * Return statistics for the application.
+     */
+    static Statistics &global();
+
+    /**
+     * Set line filter patterns and reset their hit counters (must be called
+     * before reader starts).
+     */
+    void setFilters(const QStringList &patterns);
+
+    /// Lines read from input.
+    std::atomic<qint64> linesRead;
+    /// Lines added to previous record as repeats.
+    std::atomic<qint64> linesFolded;
+    /// Lines dropped because they were seen recently.
+    std::atomic<qint64> linesDeduplicated;
+    /// Lines rejected by include/exclude filters.
+    std::atomic<qint64> linesFiltered;
+    /// Line filter patterns and number of lines decided by each.
+    QStringList filterPatterns;
+    std::unique_ptr< std::atomic<qint64>[] > filterHits;
+    /// Batches of lines sent by reader but not yet processed.
+    std::atomic<int> pendingBatches;
+    std::atomic<qint64> iconRenders;
+    std::atomic<qint64> notificationsShown;
+    /// Times notification was postponed because of notification budget.
+    std::atomic<qint64> notificationsPostponed;
+    /// Records dropped because they could not be stored.
+    std::atomic<qint64> recordsDropped;
+    /// Number of records kept.
+    std::atomic<qint64> records;
+    /// Approximate size of records kept (including search index).
+    std::atomic<qint64> recordBytes;
+};
+
+/**
+ * Computes rates from statistics and optionally writes them periodically as
+ * JSON lines.
+ */
+class StatisticsReporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StatisticsReporter(QObject *parent = nullptr);
+
+    ~StatisticsReporter();
+
+    /**
+     * Write statistics every @a interval milliseconds to file (standard error
+     * output if @a fileName is empty).
+     */
+    bool startReporting(int interval, const QString &fileName);
+
+    /**
+     * Return human-readable statistics.
+     */
+    QString summary() const;
+
+    /**
+     * Return statistics as single line JSON.
+     */
+    QString toJson() const;
+
+private slots:
+    void update();
+
+private:
+    const Statistics &stats_;
+
+    QTimer timerUpdate_;
+    QElapsedTimer lastUpdate_;
+    qint64 lastLines_;
+    qint64 lastIconRenders_;
+    double linesPerSecond_;
+    double peakLinesPerSecond_;
+    double iconRendersPerSecond_;
+
+    int reportInterval_;
+    QElapsedTimer lastReport_;
+    std::unique_ptr<QFile> file_;
+};
+
+} // namespace traypost
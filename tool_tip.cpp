@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tool_tip.h"
+
+#include "message_format.h"
+
+namespace traypost {
+
+RecordsToolTip::RecordsToolTip(int maxLines)
+    : ring_( qMax(1, maxLines) )
+    , head_(0)
+    , count_(0)
+    , total_(0)
+{
+}
+
+void RecordsToolTip::setMaxLines(int maxLines)
+{
+    ring_ = QVector<Snippet>( qMax(1, maxLines) );
+    clear();
+}
+
+void RecordsToolTip::append(const Record &record, qint64 id)
+{
+    int index;
+    if ( count_ < ring_.size() ) {
+        index = (head_ + count_) % ring_.size();
+        ++count_;
+    } else {
+        index = head_;
+        head_ = (head_ + 1) % ring_.size();
+    }
+
+    Snippet &snippet = ring_[index];
+    snippet.record = record;
+    snippet.id = id;
+    snippet.html.clear();
+
+    ++total_;
+}
+
+void RecordsToolTip::updateLast(const Record &record)
+{
+    if (count_ == 0)
+        return;
+
+    Snippet &snippet = ring_[(head_ + count_ - 1) % ring_.size()];
+    snippet.record = record;
+    snippet.html.clear();
+}
+
+void RecordsToolTip::clear()
+{
+    head_ = 0;
+    count_ = 0;
+    total_ = 0;
+    for (auto &snippet : ring_) {
+        snippet.record = Record();
+        snippet.html.clear();
+    }
+}
+
+void RecordsToolTip::invalidate()
+{
+    for (auto &snippet : ring_)
+        snippet.html.clear();
+}
+
+QString RecordsToolTip::toHtml(const MessageFormat &format)
+{
+    QString msg = total_ > count_ ? QString("<p>...</p>") : QString();
+    for (int i = 0; i < count_; ++i) {
+        Snippet &snippet = ring_[(head_ + i) % ring_.size()];
+        if ( snippet.html.isNull() )
+            snippet.html = format.format(snippet.record, snippet.id);
+        msg.append(snippet.html);
+    }
+    return msg;
+}
+
+} // namespace traypost
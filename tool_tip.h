@@ -0,0 +1,88 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "record.h"
+
+#include <QString>
+#include <QVector>
+
+namespace traypost {
+
+class MessageFormat;
+
+/**
+ * Tray tool tip with last new records.
+ *
+ * Keeps ring of last records; each record is formatted at most once, when
+ * tool tip is first created after the record was added. Older records are
+ * replaced by "...".
+ */
+class RecordsToolTip
+{
+public:
+    explicit RecordsToolTip(int maxLines = 10);
+
+    /**
+     * Set maximum number of records shown (drops all records).
+     */
+    void setMaxLines(int maxLines);
+
+    int maxLines() const { return ring_.size(); }
+
+    /**
+     * Add new record with given ID (drops the oldest one if ring is full).
+     */
+    void append(const Record &record, qint64 id);
+
+    /**
+     * Replace last record (e.g. after it was repeated).
+     */
+    void updateLast(const Record &record);
+
+    void clear();
+
+    /**
+     * Format all records again when needed (e.g. after format changed).
+     */
+    void invalidate();
+
+    /**
+     * Return tool tip HTML.
+     */
+    QString toHtml(const MessageFormat &format);
+
+private:
+    struct Snippet {
+        Record record;
+        qint64 id;
+        /// Formatted record (null if not yet formatted).
+        QString html;
+    };
+
+    QVector<Snippet> ring_;
+    /// Index of the oldest snippet.
+    int head_;
+    int count_;
+    /// Number of records appended since last clear.
+    qint64 total_;
+};
+
+} // namespace traypost
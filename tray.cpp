@@ -18,24 +18,37 @@
 */
 
 #include "tray.h"
+#include "icon_renderer.h"
 #include "log_dialog.h"
+#include "log_export.h"
+#include "message_format.h"
+#include "notification_scheduler.h"
+#include "disk_record_store.h"
+#include "record_store.h"
+#include "statistics.h"
+#include "tool_tip.h"
+#include "trigram_index.h"
 
 #include <QApplication>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QLabel>
+#include <QFileDialog>
 #include <QLayout>
 #include <QMenu>
-#include <QPainter>
+#include <QMessageBox>
 #include <QPointer>
+#include <QProgressDialog>
 #include <QSystemTrayIcon>
 #include <QTimer>
 
 #include <iostream>
+#include <memory>
 
 namespace traypost {
 
-constexpr int maxMessageLines = 10;
+/// Number of steps in export progress bar.
+constexpr int exportProgressSteps = 1000;
 
 class TrayPrivate : public QObject {
     Q_OBJECT
@@ -43,18 +56,40 @@ public:
     TrayPrivate(Tray *parent)
         : QObject(parent)
         , q_ptr(parent)
+        , textFont_()
+        , textColor_(Qt::black)
+        , textOutlineColor_(Qt::white)
+        , warningColor_(255, 140, 0)
+        , errorColor_(Qt::red)
         , lines_(0)
+        , levelCounts_(Record::ErrorLevel + 1, 0)
+        , maxLevel_(Record::NoLevel)
+        , hasLevels_(false)
+        , toolTip_()
+        , records_(new MemoryRecordStore)
+        , maxRecords_(0)
+        , maxBytes_(0)
+        , maxAge_(0)
         , inputRead_(false)
         , recordEnd_(false)
         , endOfInput_(false)
         , selectMode_(false)
         , timeout_(8000)
+        , iconDirty_(true)
+        , iconUpdateInterval_(100)
     {
         tray_.setToolTip( tr("No messages available.") );
         createMenu();
         connectSignals();
     }
 
+    ~TrayPrivate()
+    {
+        // Dialog searches records and index in worker threads so it must be
+        // destroyed (waiting for the search) before them.
+        delete dialogLog_;
+    }
+
     void createMenu()
     {
         Q_Q(Tray);
@@ -68,6 +103,17 @@ public:
         actionShowLog_ = menu_.addAction( QIcon::fromTheme("document-open"), tr("&Show Log"),
                                           q, SLOT(showLog()) );
 
+        menu_.addAction( QIcon::fromTheme("document-save-as"), tr("&Export..."),
+                         this, SLOT(exportLog()) );
+
+        // Number of records and memory used
+        actionRecords_ = menu_.addAction( QString() );
+        actionRecords_->setEnabled(false);
+
+        // Statistics
+        menu_.addAction( tr("S&tatistics"), this, SLOT(showStatistics()) );
+        menu_.addSeparator();
+
         // Exit
         menu_.addAction( QIcon::fromTheme("application-exit"), tr("E&xit"),
                          q, SLOT(exit()) );
@@ -80,22 +126,30 @@ public:
         connect(&tray_, SIGNAL(activated(QSystemTrayIcon::ActivationReason)),
                 this, SLOT(onTrayActivated(QSystemTrayIcon::ActivationReason)));
 
-        timerMessage_.setInterval(1000);
-        timerMessage_.setSingleShot(true);
-        connect( &timerMessage_, SIGNAL(timeout()), SLOT(showMessage()) );
+        connect( &notificationScheduler_, SIGNAL(notify(int)), SLOT(showMessage(int)) );
+
+        timerIcon_.setSingleShot(true);
+        connect( &timerIcon_, SIGNAL(timeout()), SLOT(updateIcon()) );
+
+        timerEvict_.setInterval(1000);
+        connect( &timerEvict_, SIGNAL(timeout()), SLOT(evictRecords()) );
+
+        connect( &menu_, SIGNAL(aboutToShow()), SLOT(updateMenu()) );
     }
 
     void show()
     {
         tray_.show();
-        setIconText(iconText_);
+        updateIcon();
     }
 
     void setIcon(const QIcon &icon)
     {
         icon_ = icon;
+        iconRenderer_.setIcon(icon);
+        iconDirty_ = true;
         if ( tray_.isVisible() )
-            setIconText(iconText_);
+            updateIcon();
         else
             tray_.setIcon(icon_);
     }
@@ -103,78 +157,93 @@ public:
     void setIconText(const QString &text)
     {
         iconText_ = text;
+        scheduleIconUpdate();
+    }
 
-        if ( !tray_.isVisible() )
-            return;
-
-        QIcon icon;
-        auto sizes = icon_.availableSizes();
-
-        Q_ASSERT( !sizes.empty() );
+    void setIconFps(int fps)
+    {
+        iconUpdateInterval_ = fps > 0 ? 1000 / fps : 0;
+    }
 
+    /**
+     * Update icon later so it's not rendered more often than allowed.
+     */
+    void scheduleIconUpdate()
+    {
+        if ( timerIcon_.isActive() )
+            return;
 
-        // Current tray icon size.
-        auto currentSize = tray_.geometry().size();
-        if ( !sizes.contains(currentSize) ) {
-            sizes.push_back(currentSize);
-            QSize fromSize = sizes.first();
-            for (const QSize &size : sizes) {
-                if ( size.width() >= currentSize.width() && size.height() >= currentSize.height() ) {
-                    fromSize = size;
-                    break;
-                }
-            }
+        const qint64 elapsed = lastIconUpdate_.isValid()
+                ? lastIconUpdate_.elapsed() : iconUpdateInterval_;
+        timerIcon_.start( static_cast<int>(qMax<qint64>(0, iconUpdateInterval_ - elapsed)) );
+    }
 
-            icon.addPixmap( icon_.pixmap(fromSize).scaled(currentSize) );
+    bool setLogFile(const QString &path, QString *errorString)
+    {
+        std::unique_ptr<DiskRecordStore> store(new DiskRecordStore);
+        if ( !store->open(path) ) {
+            if (errorString != nullptr)
+                *errorString = store->errorString();
+            return false;
         }
 
-        // Render text in icon pixmaps.
-        for (const QSize &size : sizes) {
-            QPixmap pix( icon_.pixmap(size) );
-            if ( pix.isNull())
-                continue;
-            QPainter p(&pix);
-
-            // text position
-            QFontMetrics fm(iconTextFont_);
-            auto textSize = fm.size(Qt::TextSingleLine, text);
-            const int x = ( size.width() - textSize.width() ) / 2;
-            const int y = ( size.height() + textSize.height() ) / 2 - fm.descent();
-
-            // Draw text outline.
-            QPainterPath path;
-            path.addText(x, y, iconTextFont_, text);
-            p.setPen(QPen(iconTextOutlineColor_, 2));
-            p.setBrush(iconTextOutlineColor_);
-            p.drawPath(path);
-
-            // Draw text.
-            p.setFont(iconTextFont_);
-            p.setPen(iconTextColor_);
-            p.drawText(x, y, text);
-
-            icon.addPixmap(pix);
-        }
+        store->setLimits(maxRecords_, maxBytes_, maxAge_);
+        records_ = std::move(store);
+        return true;
+    }
 
-        tray_.setIcon(icon);
+    void setRecordLimits(int maxRecords, qint64 maxBytes, qint64 maxAge)
+    {
+        maxRecords_ = maxRecords;
+        maxBytes_ = maxBytes;
+        maxAge_ = maxAge;
+        records_->setLimits(maxRecords, maxBytes, maxAge);
+        if (maxAge > 0)
+            timerEvict_.start();
+        else
+            timerEvict_.stop();
+        evictRecords();
+    }
 
-        bool showReset = !iconText_.isEmpty();
+    void setIconTextStyle(const QFont &font, const QColor &color, const QColor &outlineColor)
+    {
+        textFont_ = font;
+        textColor_ = color;
+        textOutlineColor_ = outlineColor;
+        updateIconTextStyle();
+    }
 
-        actionReset_->setVisible(showReset);
-        menu_.setDefaultAction(showReset ? actionReset_ : actionShowLog_);
+    void setLevelColors(const QColor &warningColor, const QColor &errorColor)
+    {
+        warningColor_ = warningColor;
+        errorColor_ = errorColor;
+        updateIconTextStyle();
     }
 
-    void setIconTextStyle(const QFont &font, const QColor &color, const QColor &outlineColor)
+    /**
+     * Set icon text color by most severe level of new records.
+     */
+    void updateIconTextStyle()
     {
-        iconTextFont_ = font;
-        iconTextColor_ = color;
-        iconTextOutlineColor_ = outlineColor;
-        setIconText(iconText_);
+        const QColor &color = maxLevel_ == Record::ErrorLevel ? errorColor_
+                            : maxLevel_ == Record::WarningLevel ? warningColor_
+                            : textColor_;
+        iconRenderer_.setTextStyle(textFont_, color, textOutlineColor_);
+        iconDirty_ = true;
+        updateIcon();
     }
 
     void resetMessages()
     {
         lines_ = 0;
+        sourceCounts_.fill(0);
+        levelCounts_.fill(0);
+        toolTip_.clear();
+        notificationScheduler_.reset();
+        if (maxLevel_ != Record::NoLevel) {
+            maxLevel_ = Record::NoLevel;
+            updateIconTextStyle();
+        }
         setIconText( QString() );
         tray_.setToolTip( QString() );
     }
@@ -189,13 +258,18 @@ public:
             return;
         }
 
-        dialogLog_ = new LogDialog(records_, recordFormat_, timeFormat_);
+        dialogLog_ = new LogDialog(*records_, searchIndex_, messageFormat_);
+        dialogLog_->setSources(sources_);
+        dialogLog_->setLevelFilterVisible(hasLevels_);
+        if (selectMode_)
+            dialogLog_->setSearchMode(SearchQuery::Fuzzy);
         dialogLog_->setWindowIcon(icon_);
         dialogLog_->resize(480, 480);
         dialogLog_->show();
 
         connect( dialogLog_, SIGNAL(itemActivated(int)), this, SLOT(onItemActivated(int)) );
         connect( dialogLog_, SIGNAL(finished(int)), this, SLOT(onLogDialogClosed()) );
+        connect( dialogLog_, SIGNAL(exportRequested()), this, SLOT(exportLog()) );
     }
 
     void onInputLine(const QString &line)
@@ -204,6 +278,24 @@ public:
         setToolTip(line);
     }
 
+    void onInputRecords(const QVector<Record> &records)
+    {
+        inputRead_ = true;
+        for (const auto &record : records)
+            addRecord(record);
+    }
+
+    void onInputRepeated(int count, qint64 lastSeen)
+    {
+        if (endOfInput_)
+            return;
+
+        records_->repeatLast(count, lastSeen);
+        toolTip_.updateLast( records_->last() );
+        if (dialogLog_ != nullptr)
+            dialogLog_->updateLastRecord();
+    }
+
     void onInputEnd()
     {
         if (inputRead_ && recordEnd_)
@@ -211,21 +303,75 @@ public:
     }
 
 public slots:
+    /**
+     * Render icon text in icon pixmaps if the text or style changed.
+     */
+    void updateIcon()
+    {
+        if ( !tray_.isVisible() )
+            return;
+
+        if ( !iconDirty_ && renderedIconText_ == iconText_ )
+            return;
+
+        timerIcon_.stop();
+        lastIconUpdate_.start();
+        iconDirty_ = false;
+        renderedIconText_ = iconText_;
+
+        tray_.setIcon( iconRenderer_.icon(iconText_, tray_.geometry().size()) );
+        ++Statistics::global().iconRenders;
+
+        bool showReset = !iconText_.isEmpty();
+
+        actionReset_->setVisible(showReset);
+        menu_.setDefaultAction(showReset ? actionReset_ : actionShowLog_);
+    }
+
     void setToolTip(const QString &text, bool endOfInput = false)
+    {
+        addRecord( Record(text), endOfInput );
+    }
+
+    void addRecord(const Record &record, bool endOfInput = false)
     {
         if (endOfInput_)
             return;
 
         endOfInput_ = endOfInput;
 
-        records_.append( Record(text) );
+        const qint64 id = records_->nextId();
+        if ( !records_->append(record) ) {
+            ++Statistics::global().recordsDropped;
+            return;
+        }
+
+        toolTip_.append(record, id);
+        searchIndex_.add(id, record.text);
+        evict();
+        updateRecordStatistics();
+
+        notificationScheduler_.addRecords();
+
+        if ( record.source < sourceCounts_.size() )
+            ++sourceCounts_[record.source];
 
-        timerMessage_.start();
+        ++levelCounts_[record.level];
+        if (!hasLevels_ && record.level != Record::NoLevel) {
+            hasLevels_ = true;
+            if (dialogLog_ != nullptr)
+                dialogLog_->setLevelFilterVisible(true);
+        }
+        if (record.level > maxLevel_) {
+            maxLevel_ = record.level;
+            if (maxLevel_ >= Record::WarningLevel)
+                updateIconTextStyle();
+        }
 
         setIconText( QString::number(++lines_) );
 
         if (dialogLog_ != nullptr)
-            dialogLog_->addRecord( records_.last() );
+            dialogLog_->updateRecords();
     }
 
     void onTrayActivated(QSystemTrayIcon::ActivationReason reason)
@@ -247,8 +393,8 @@ public slots:
     void onItemActivated(int row)
     {
         Q_Q(Tray);
-        if ( (row + (endOfInput_ ? 1 : 0)) < records_.size() ) {
-            std::cout << records_[row].text.toStdString() << std::endl;
+        if ( row >= 0 && (row + (endOfInput_ ? 1 : 0)) < records_->size() ) {
+            std::cout << records_->at(row).text.toStdString() << std::endl;
             if (selectMode_) {
                 // Avoid ending with non-zero exit code after next exit call.
                 selectMode_ = false;
@@ -257,18 +403,135 @@ public slots:
         }
     }
 
-    void showMessage()
+    void showMessage(int count)
     {
-        const auto size = records_.size();
-        int maxLines = qMin(maxMessageLines, lines_);
-        QString msg = lines_ > maxLines ? QString("<p>...</p>") : QString();
-        for (int i = qMax(0, size - maxLines); i < size; ++i) {
-            msg.append( records_[i].toString(recordFormat_, timeFormat_) );
-        }
-        tray_.setToolTip(msg);
+        if ( records_->isEmpty() )
+            return;
+
+        tray_.setToolTip( levelsToolTip() + sourcesToolTip() + toolTip_.toHtml(messageFormat_) );
+
+        // Show digest if there are multiple new records.
+        const QString lastText = records_->last().text;
+        const QString message = count > 1
+                ? tr("%n new messages, last: %1", "", count).arg(lastText)
+                : lastText;
 
-        tray_.showMessage(QString("TrayPost"), records_.last().text, QSystemTrayIcon::NoIcon,
+        tray_.showMessage(QString("TrayPost"), message, QSystemTrayIcon::NoIcon,
                           timeout_);
+        ++Statistics::global().notificationsShown;
+    }
+
+    void evictRecords()
+    {
+        if ( evict() == 0 )
+            return;
+
+        updateRecordStatistics();
+        if (dialogLog_ != nullptr)
+            dialogLog_->updateRecords();
+    }
+
+    void updateMenu()
+    {
+        const double mib = records_->bytes() / (1024.0 * 1024.0);
+        const double indexMib = searchIndex_.bytes() / (1024.0 * 1024.0);
+        actionRecords_->setText(
+                    tr("Records: %1 (%2 MiB, search index %3 MiB)")
+                    .arg( records_->size() )
+                    .arg(mib, 0, 'f', 1)
+                    .arg(indexMib, 0, 'f', 1) );
+    }
+
+    void setInputSources(const QStringList &names)
+    {
+        sources_ = names;
+        sourceCounts_.resize( names.size() );
+        if (dialogLog_ != nullptr)
+            dialogLog_->setSources(sources_);
+        if (logExport_ != nullptr)
+            logExport_->setSources(sources_);
+    }
+
+    /**
+     * Return new record counts for each input (empty for single input).
+     */
+    QString sourcesToolTip() const
+    {
+        if (sources_.size() < 2)
+            return QString();
+
+        QStringList counts;
+        for (int i = 0; i < sources_.size(); ++i)
+            counts.append( QString("<b>%1</b>: %2").arg(escapeHtml(sources_[i])).arg(sourceCounts_[i]) );
+
+        return "<p>" + counts.join(", ") + "</p>";
+    }
+
+    /**
+     * Return number of new errors and warnings (empty if there are none).
+     */
+    QString levelsToolTip() const
+    {
+        QStringList counts;
+        if (levelCounts_[Record::ErrorLevel] > 0)
+            counts.append( tr("<b>Errors</b>: %1").arg(levelCounts_[Record::ErrorLevel]) );
+        if (levelCounts_[Record::WarningLevel] > 0)
+            counts.append( tr("<b>Warnings</b>: %1").arg(levelCounts_[Record::WarningLevel]) );
+
+        if ( counts.isEmpty() )
+            return QString();
+
+        return "<p>" + counts.join(", ") + "</p>";
+    }
+
+    /**
+     * Ask for file name and export log in background.
+     */
+    void exportLog()
+    {
+        const QString fileName = QFileDialog::getSaveFileName(
+                    dialogLog_, tr("TrayPost - Export Log"), QString(),
+                    tr("Text files (*.txt);;JSON Lines (*.jsonl);;CSV files (*.csv);;All files (*)") );
+        if ( fileName.isEmpty() )
+            return;
+
+        if (exportProgress_ == nullptr) {
+            exportProgress_ = new QProgressDialog();
+            exportProgress_->setWindowTitle( tr("TrayPost - Export Log") );
+            exportProgress_->setRange(0, exportProgressSteps);
+            connect( exportProgress_, SIGNAL(canceled()), logExport(), SLOT(cancel()) );
+            connect( exportProgress_, SIGNAL(canceled()), exportProgress_, SLOT(deleteLater()) );
+        }
+
+        exportProgress_->setLabelText( tr("Exporting log to \"%1\"...").arg(fileName) );
+        exportProgress_->setValue(0);
+        logExport()->start( fileName, LogExport::formatForFileName(fileName) );
+    }
+
+    void onExportProgress(qint64 written, qint64 total)
+    {
+        if (exportProgress_ != nullptr && total > 0)
+            exportProgress_->setValue( static_cast<int>(written * exportProgressSteps / total) );
+    }
+
+    void onExportFinished(bool ok, const QString &errorString)
+    {
+        const bool interactive = exportProgress_ != nullptr;
+        if (interactive)
+            exportProgress_->deleteLater();
+
+        if (ok)
+            return;
+
+        if (interactive)
+            QMessageBox::warning( nullptr, tr("TrayPost - Export Log"), errorString );
+        else
+            std::cerr << errorString.toLocal8Bit().constData() << std::endl;
+    }
+
+    void showStatistics()
+    {
+        QMessageBox::information( nullptr, tr("TrayPost Statistics"), statistics_.summary() );
     }
 
     void onLogDialogClosed()
@@ -287,22 +550,42 @@ protected:
     QMenu menu_;
     QPointer<QAction> actionReset_;
     QPointer<QAction> actionShowLog_;
+    QPointer<QAction> actionRecords_;
     QPointer<LogDialog> dialogLog_;
     QIcon icon_;
 
     QString iconText_;
-    QFont iconTextFont_;
-    QColor iconTextColor_;
-    QColor iconTextOutlineColor_;
+    IconRenderer iconRenderer_;
+    QFont textFont_;
+    QColor textColor_;
+    QColor textOutlineColor_;
+    QColor warningColor_;
+    QColor errorColor_;
 
     int lines_;
 
-    QList<Record> records_;
+    /// Input names and number of new records from each.
+    QStringList sources_;
+    QVector<int> sourceCounts_;
+
+    /// Number of new records for each level and most severe level of them.
+    QVector<int> levelCounts_;
+    Record::Level maxLevel_;
+    /// Some record has level (level filter is shown in log dialog).
+    bool hasLevels_;
+
+    /// Last new records shown in tool tip.
+    RecordsToolTip toolTip_;
+
+    std::unique_ptr<RecordStore> records_;
+    int maxRecords_;
+    qint64 maxBytes_;
+    qint64 maxAge_;
+    TrigramIndex searchIndex_;
 
     bool inputRead_;
 
-    QString timeFormat_;
-    QString recordFormat_;
+    MessageFormat messageFormat_;
 
     bool recordEnd_;
     bool endOfInput_;
@@ -310,7 +593,74 @@ protected:
     bool selectMode_;
 
     int timeout_;
-    QTimer timerMessage_;
+    NotificationScheduler notificationScheduler_;
+
+    QString renderedIconText_;
+    bool iconDirty_;
+    int iconUpdateInterval_;
+    QElapsedTimer lastIconUpdate_;
+    QTimer timerIcon_;
+
+    QTimer timerEvict_;
+
+    StatisticsReporter statistics_;
+
+    std::unique_ptr<LogExport> logExport_;
+    QPointer<QProgressDialog> exportProgress_;
+    QString exportOnExit_;
+
+private:
+    void updateRecordStatistics()
+    {
+        Statistics &stats = Statistics::global();
+        stats.records = records_->size();
+        stats.recordBytes = records_->bytes() + searchIndex_.bytes();
+    }
+
+    /**
+     * Remove records exceeding limits (search index counts to memory limit).
+     * @return number of removed records
+     */
+    int evict()
+    {
+        int removed = 0;
+        forever {
+            // Index shrinks with removed records so the limit is checked again.
+            records_->setExtraBytes( searchIndex_.bytes() );
+            const int count = records_->evict();
+            if (count == 0)
+                return removed;
+            removed += count;
+            searchIndex_.removeBefore( records_->firstId() );
+        }
+    }
+
+    LogExport *logExport()
+    {
+        if (logExport_ == nullptr) {
+            logExport_.reset( new LogExport(*records_) );
+            connect( logExport_.get(), SIGNAL(progress(qint64,qint64)),
+                     this, SLOT(onExportProgress(qint64,qint64)) );
+            connect( logExport_.get(), SIGNAL(finished(bool,QString)),
+                     this, SLOT(onExportFinished(bool,QString)) );
+        }
+
+        logExport_->setSources(sources_);
+        return logExport_.get();
+    }
+
+    /**
+     * Export log to file set by Tray::setExportOnExit() and wait for it.
+     */
+    void exportOnExit()
+    {
+        if ( exportOnExit_.isEmpty() )
+            return;
+
+        delete exportProgress_;
+        logExport()->start( exportOnExit_, LogExport::formatForFileName(exportOnExit_) );
+        logExport()->waitForFinished();
+    }
 };
 
 Tray::Tray(QObject *parent)
@@ -343,22 +693,61 @@ void Tray::setIconText(const QString &text)
     d->setIconText(text);
 }
 
+bool Tray::setLogFile(const QString &path, QString *errorString)
+{
+    Q_D(Tray);
+    return d->setLogFile(path, errorString);
+}
+
+bool Tray::setStatisticsReport(int interval, const QString &fileName)
+{
+    Q_D(Tray);
+    return d->statistics_.startReporting(interval, fileName);
+}
+
+void Tray::setNotificationLimits(int debounce, int maxDelay, int budget)
+{
+    Q_D(Tray);
+    d->notificationScheduler_.setDebounce(debounce);
+    d->notificationScheduler_.setMaxDelay(maxDelay);
+    d->notificationScheduler_.setBudget(budget);
+}
+
+void Tray::setRecordLimits(int maxRecords, qint64 maxBytes, qint64 maxAge)
+{
+    Q_D(Tray);
+    d->setRecordLimits(maxRecords, maxBytes, maxAge);
+}
+
 void Tray::setIconTextStyle(const QFont &font, const QColor &color, const QColor &outlineColor)
 {
     Q_D(Tray);
     d->setIconTextStyle(font, color, outlineColor);
 }
 
-void Tray::setTimeFormat(const QString &format)
+void Tray::setLevelColors(const QColor &warningColor, const QColor &errorColor)
 {
     Q_D(Tray);
-    d->timeFormat_ = format;
+    d->setLevelColors(warningColor, errorColor);
 }
 
-void Tray::setMessageFormat(const QString &format)
+void Tray::setToolTipLines(int lines)
 {
     Q_D(Tray);
-    d->recordFormat_ = format;
+    d->toolTip_.setMaxLines(lines);
+}
+
+void Tray::setIconFps(int fps)
+{
+    Q_D(Tray);
+    d->setIconFps(fps);
+}
+
+void Tray::setMessageFormat(const MessageFormat &format)
+{
+    Q_D(Tray);
+    d->messageFormat_ = format;
+    d->toolTip_.invalidate();
 }
 
 void Tray::setRecordInputEnd(bool enable)
@@ -373,6 +762,18 @@ void Tray::setSelectMode(bool enable)
     d->selectMode_ = enable;
 }
 
+void Tray::setExportOnExit(const QString &fileName)
+{
+    Q_D(Tray);
+    d->exportOnExit_ = fileName;
+}
+
+void Tray::setInputSources(const QStringList &names)
+{
+    Q_D(Tray);
+    d->setInputSources(names);
+}
+
 void Tray::show()
 {
     Q_D(Tray);
@@ -383,7 +784,19 @@ void Tray::onInputLine(const QString &line)
 {
     Q_D(Tray);
     d->onInputLine(line);
-    emit readLine();
+}
+
+void Tray::onInputRecords(const QVector<traypost::Record> &records)
+{
+    Q_D(Tray);
+    d->onInputRecords(records);
+    emit inputProcessed();
+}
+
+void Tray::onInputRepeated(int count, qint64 lastSeen)
+{
+    Q_D(Tray);
+    d->onInputRepeated(count, lastSeen);
 }
 
 void Tray::onInputEnd()
@@ -394,6 +807,11 @@ void Tray::onInputEnd()
 
 void Tray::exit(int exitCode)
 {
+    Q_D(Tray);
+    // Search workers must not run while records are destroyed after exit.
+    if (d->dialogLog_ != nullptr)
+        d->dialogLog_->stopSearch();
+    d->exportOnExit();
     QApplication::exit(exitCode);
 }
 
@@ -19,12 +19,17 @@
 
 #pragma once
 
+#include "record.h"
+
 #include <QMainWindow>
+#include <QStringList>
+#include <QVector>
 
 #include <memory>
 
 namespace traypost {
 
+class MessageFormat;
 class TrayPrivate;
 
 class Tray : public QObject
@@ -44,6 +49,13 @@ public:
      */
     void setMessageTimeout(int ms);
 
+    /**
+     * Set time without new messages after which notification is shown,
+     * maximum delay of notification (both in milliseconds) and maximum number
+     * of notifications per minute (zero for no limit).
+     */
+    void setNotificationLimits(int debounce, int maxDelay, int budget);
+
     /**
      * Set tray icon.
      */
@@ -54,20 +66,45 @@ public:
      */
     void setIconText(const QString &text);
 
+    /**
+     * Keep records in memory-mapped files (temporary files if @a path is empty)
+     * instead of memory.
+     *
+     * Must be called before any record is added. Records which cannot be
+     * written later (e.g. disk is full) are dropped.
+     */
+    bool setLogFile(const QString &path, QString *errorString = nullptr);
+
+    /**
+     * Set maximum number of records, memory taken by records (in bytes) and
+     * age of records (in milliseconds); zero means no limit.
+     */
+    void setRecordLimits(int maxRecords, qint64 maxBytes, qint64 maxAge);
+
     /**
      * Set icon text font, text color and text outline color.
      */
     void setIconTextStyle(const QFont &font, const QColor &color, const QColor &outlineColor);
 
     /**
-     * Set format of time.
+     * Set icon text color used while there are new warnings or errors.
+     */
+    void setLevelColors(const QColor &warningColor, const QColor &errorColor);
+
+    /**
+     * Set maximum number of icon updates per second (zero for no limit).
+     */
+    void setIconFps(int fps);
+
+    /**
+     * Set maximum number of last new records shown in tool tip.
      */
-    void setTimeFormat(const QString &format);
+    void setToolTipLines(int lines);
 
     /**
      * Set format of each message/record.
      */
-    void setMessageFormat(const QString &format);
+    void setMessageFormat(const MessageFormat &format);
 
     /**
      * Add special item "END OF INPUT" after stdin read.
@@ -79,14 +116,38 @@ public:
      */
     void setSelectMode(bool enable);
 
+    /**
+     * Write runtime statistics every @a interval milliseconds as JSON lines to
+     * file (standard error output if @a fileName is empty).
+     */
+    bool setStatisticsReport(int interval, const QString &fileName = QString());
+
+    /**
+     * Export log to file at exit (format is chosen by file name suffix: ".jsonl",
+     * ".csv" or plain text).
+     */
+    void setExportOnExit(const QString &fileName);
+
     /**
      * Show tray icon.
      */
     void show();
 
 public slots:
+    /**
+     * Set input names to show number of new records from each input.
+     */
+    void setInputSources(const QStringList &names);
+
     void onInputLine(const QString &line);
 
+    void onInputRecords(const QVector<traypost::Record> &records);
+
+    /**
+     * Add @a count repeats to last record.
+     */
+    void onInputRepeated(int count, qint64 lastSeen);
+
     void onInputEnd();
 
     void exit(int exitCode = 0);
@@ -99,7 +160,10 @@ public slots:
     void showLog();
 
 signals:
-    void readLine();
+    /**
+     * Emitted after batch of input lines is processed.
+     */
+    void inputProcessed();
 
 private:
     TrayPrivate * const d_ptr;
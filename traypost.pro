@@ -15,12 +15,47 @@ SOURCES += main.cpp \
     tray.cpp \
     launcher.cpp \
     console_reader.cpp \
-    log_dialog.cpp
+    disk_record_store.cpp \
+    log_dialog.cpp \
+    log_export.cpp \
+    icon_renderer.cpp \
+    keyword_matcher.cpp \
+    line_filter.cpp \
+    line_parser.cpp \
+    line_splitter.cpp \
+    log_item_delegate.cpp \
+    log_model.cpp \
+    log_search.cpp \
+    message_format.cpp \
+    notification_scheduler.cpp \
+    post_client.cpp \
+    record_store.cpp \
+    statistics.cpp \
+    tool_tip.cpp \
+    trigram_index.cpp
 
 HEADERS  += tray.h \
     launcher.h \
     console_reader.h \
-    log_dialog.h
+    disk_record_store.h \
+    log_dialog.h \
+    log_export.h \
+    icon_renderer.h \
+    keyword_matcher.h \
+    line_filter.h \
+    line_parser.h \
+    line_splitter.h \
+    log_item_delegate.h \
+    log_model.h \
+    log_search.h \
+    message_format.h \
+    notification_scheduler.h \
+    post_client.h \
+    record.h \
+    record_store.h \
+    statistics.h \
+    tool_tip.h \
+    trigram_index.h
 
 QMAKE_CXXFLAGS += -std=c++0x
 
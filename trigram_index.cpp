@@ -0,0 +1,187 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "trigram_index.h"
+
+#include <algorithm>
+
+namespace traypost {
+
+namespace {
+
+/// Compact posting lists only if there are many removed records.
+constexpr qint64 minRemovedToCompact = 4096;
+
+/// Size of record ID in posting list.
+constexpr qint64 postingBytes = sizeof(quint32);
+
+/// Approximate memory used by hash node and empty posting list.
+constexpr qint64 postingListOverhead = 64;
+
+quint64 trigram(const QChar *c)
+{
+    return (static_cast<quint64>( c[0].unicode() ) << 32)
+         | (static_cast<quint64>( c[1].unicode() ) << 16)
+         | c[2].unicode();
+}
+
+QString caseFolded(const QString &text)
+{
+    QString result(text);
+    for (QChar &c : result)
+        c = c.toCaseFolded();
+    return result;
+}
+
+/**
+ * Keep only items in @a ids which are also in @a other (both sorted).
+ */
+void intersect(QVector<quint32> *ids, const QVector<quint32> &other)
+{
+    auto out = ids->begin();
+    auto it = other.constBegin();
+    for (quint32 id : *ids) {
+        it = std::lower_bound(it, other.constEnd(), id);
+        if ( it == other.constEnd() )
+            break;
+        if (*it == id)
+            *out++ = id;
+    }
+    ids->resize( static_cast<int>(out - ids->begin()) );
+}
+
+} // namespace
+
+constexpr int TrigramIndex::minQueryLength;
+
+TrigramIndex::TrigramIndex()
+    : postings_()
+    , recordPostings_()
+    , bytes_(0)
+    , baseId_(0)
+    , firstId_(0)
+    , nextId_(0)
+{
+}
+
+void TrigramIndex::add(qint64 id, const QString &text)
+{
+    Q_ASSERT(id >= nextId_);
+    nextId_ = id + 1;
+
+    const quint32 relativeId = static_cast<quint32>(id - baseId_);
+    bytes_ += (relativeId + 1 - recordPostings_.size()) * postingBytes;
+    recordPostings_.resize(relativeId + 1);
+
+    if (text.size() < minQueryLength)
+        return;
+
+    const QString folded = caseFolded(text);
+    const QChar *c = folded.constData();
+
+    quint32 &count = recordPostings_.last();
+    for (int i = 0; i + minQueryLength <= folded.size(); ++i) {
+        Postings &ids = postings_[trigram(c + i)];
+        if ( ids.isEmpty() )
+            bytes_ += postingListOverhead;
+        if ( ids.isEmpty() || ids.last() != relativeId ) {
+            ids.append(relativeId);
+            ++count;
+        }
+    }
+    bytes_ += count * postingBytes;
+}
+
+void TrigramIndex::removeBefore(qint64 firstId)
+{
+    // Postings of removed records are freed later in compact().
+    const qint64 end = qMin(firstId, nextId_);
+    for (qint64 id = firstId_; id < end; ++id)
+        bytes_ -= (recordPostings_[static_cast<int>(id - baseId_)] + 1) * postingBytes;
+
+    firstId_ = qMax(firstId_, firstId);
+
+    const qint64 removed = firstId_ - baseId_;
+    if ( removed >= minRemovedToCompact && removed > nextId_ - firstId_ )
+        compact();
+}
+
+bool TrigramIndex::candidates(const QString &query, QVector<qint64> *ids) const
+{
+    ids->clear();
+
+    if (query.size() < minQueryLength)
+        return false;
+
+    // Collect posting lists, shortest first.
+    const QString folded = caseFolded(query);
+    const QChar *c = folded.constData();
+    QVector<const Postings*> lists;
+    for (int i = 0; i + minQueryLength <= folded.size(); ++i) {
+        auto it = postings_.constFind( trigram(c + i) );
+        if ( it == postings_.constEnd() )
+            return true;
+        lists.append(&*it);
+    }
+
+    std::sort( lists.begin(), lists.end(),
+               [](const Postings *a, const Postings *b) { return a->size() < b->size(); } );
+
+    Postings result = *lists[0];
+    for (int i = 1; i < lists.size() && !result.isEmpty(); ++i)
+        intersect(&result, *lists[i]);
+
+    ids->reserve( result.size() );
+    for (quint32 id : result) {
+        const qint64 absoluteId = baseId_ + id;
+        if (absoluteId >= firstId_)
+            ids->append(absoluteId);
+    }
+
+    return true;
+}
+
+void TrigramIndex::compact()
+{
+    const quint32 removed = static_cast<quint32>(firstId_ - baseId_);
+
+    for (auto it = postings_.begin(); it != postings_.end(); ) {
+        Postings &ids = it.value();
+        const int count = static_cast<int>(
+                    std::lower_bound(ids.constBegin(), ids.constEnd(), removed) - ids.constBegin() );
+
+        if ( count == ids.size() ) {
+            it = postings_.erase(it);
+            bytes_ -= postingListOverhead;
+            continue;
+        }
+
+        ids.remove(0, count);
+        for (quint32 &id : ids)
+            id -= removed;
+        ids.squeeze();
+        ++it;
+    }
+
+    recordPostings_.remove( 0, qMin<int>(removed, recordPostings_.size()) );
+    recordPostings_.squeeze();
+    baseId_ = firstId_;
+}
+
+} // namespace traypost
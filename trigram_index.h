@@ -0,0 +1,81 @@
+/*
+    Copyright (c) 2013, Lukas Holecek <hluk@email.cz>
+
+    This file is part of TrayPost.
+
+    TrayPost is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    TrayPost is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with TrayPost.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace traypost {
+
+/**
+ * Index of case-folded character trigrams in record texts.
+ *
+ * Used to find candidate records possibly containing a text (case-insensitive)
+ * without scanning all records.
+ */
+class TrigramIndex
+{
+public:
+    /// Shortest query which can use the index.
+    static constexpr int minQueryLength = 3;
+
+    TrigramIndex();
+
+    /**
+     * Add text of new record (IDs must be increasing).
+     */
+    void add(qint64 id, const QString &text);
+
+    /**
+     * Forget records with lower ID.
+     */
+    void removeBefore(qint64 firstId);
+
+    /**
+     * Find records containing all trigrams of @a query.
+     *
+     * Candidate IDs are sorted and need to be verified.
+     *
+     * @return false if query is too short to use the index
+     */
+    bool candidates(const QString &query, QVector<qint64> *ids) const;
+
+    /**
+     * Return approximate size of index for remaining records in bytes.
+     */
+    qint64 bytes() const { return bytes_; }
+
+private:
+    typedef QVector<quint32> Postings;
+
+    void compact();
+
+    /// Posting lists of record IDs (relative to baseId_) for each trigram.
+    QHash<quint64, Postings> postings_;
+    /// Number of postings for each record (from baseId_).
+    QVector<quint32> recordPostings_;
+    qint64 bytes_;
+    qint64 baseId_;
+    qint64 firstId_;
+    qint64 nextId_;
+};
+
+} // namespace traypost